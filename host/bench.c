@@ -0,0 +1,376 @@
+// Simulates a day on the wrist against the host stub and reports what the face costs per minute
+// and per day: heap churn, resource loads, dirty marks, animation frames and redraws.
+//
+// The day: a minute tick every 60 s and the battery draining one percent every 15 minutes. The
+// phone answers every weather request the watch makes, with weather that changes every half
+// hour and a forecast for the next 24 hours, which the face follows hour by hour. The first
+// answer after 10:00 is lost on the way in, so the watch has to ask again, and Bluetooth drops
+// out from 13:00 to 14:00.
+//
+// At the end of the day the phone asks for the energy ledger, which has to agree hour by hour
+// with what the stub counted. After the day and a relaunch, the phone turns seconds mode on and
+// the face runs a couple of minutes on second ticks, which should each touch nothing but the
+// blinking separator. Last, the face follows a forecast hour in a timezone half an hour off UTC,
+// which should look just as it does in UTC.
+#include "pebble_stub.h"
+#include "../src/weather.h"
+#include "../src/link.h"
+#include "../src/forecast.h"
+#include "../src/ledger.h"
+#include "../src/anim_policy.h"
+
+void handle_init(void);
+void handle_deinit(void);
+
+#define MINUTES_PER_DAY 1440
+#define SECONDS_RUN 150
+
+typedef struct {
+  const char *name;
+  uint64_t (*read)(const StubCounters *c);
+} Metric;
+
+#define METRIC(field) { #field, read_##field }
+#define READER(field) static uint64_t read_##field(const StubCounters *c) { return c->field; }
+
+READER(allocs)
+READER(alloc_bytes)
+READER(resource_loads)
+READER(bitmap_creates)
+READER(mark_dirty)
+READER(frame_sets)
+READER(animations_scheduled)
+READER(animation_frames)
+READER(timers_registered)
+READER(persist_writes)
+READER(inbox_bytes)
+READER(redraws)
+READER(layer_draws)
+READER(pixels_drawn)
+
+static const Metric METRICS[] = {
+  METRIC(allocs),
+  METRIC(alloc_bytes),
+  METRIC(resource_loads),
+  METRIC(bitmap_creates),
+  METRIC(mark_dirty),
+  METRIC(frame_sets),
+  METRIC(animations_scheduled),
+  METRIC(animation_frames),
+  METRIC(timers_registered),
+  METRIC(persist_writes),
+  METRIC(inbox_bytes),
+  METRIC(redraws),
+  METRIC(layer_draws),
+  METRIC(pixels_drawn),
+};
+
+#define METRIC_COUNT ARRAY_LENGTH(METRICS)
+
+READER(dirty_layers)
+READER(dirty_pixels)
+
+// a second of seconds mode that is not also a minute tick
+static const Metric SECOND_METRICS[] = {
+  METRIC(dirty_layers),
+  METRIC(dirty_pixels),
+  METRIC(mark_dirty),
+  METRIC(allocs),
+  METRIC(resource_loads),
+  METRIC(animations_scheduled),
+};
+
+#define SECOND_METRIC_COUNT ARRAY_LENGTH(SECOND_METRICS)
+
+// Yahoo condition codes and the icons the phone maps them to
+static const uint8_t CONDITIONS[] = { 32, 30, 26, 11 };
+static const uint8_t ICONS[] = { 0, 4, 11, 8 };
+
+static bool s_settings_sent = false;
+static uint16_t s_answers = 0; // weather messages the phone delivered
+
+// what the stub saw in each hour of the day, to check the watch's energy ledger against
+typedef struct {
+  uint8_t  battery;
+  uint32_t frames;
+  uint32_t messages;
+  uint32_t message_bytes;
+  uint32_t vibes;
+  uint32_t disconnects;
+} HourTally;
+
+#define DAY_HOURS (MINUTES_PER_DAY / 60)
+
+static HourTally s_hours[DAY_HOURS + 1]; // the day's hours and the first of the next
+static uint8_t s_ledger[LEDGER_PAYLOAD_MAX];
+static uint16_t s_ledger_size = 0;
+
+static void tally(int hour, const StubCounters *before) {
+  s_hours[hour].frames += stub_counters.animation_frames - before->animation_frames;
+  s_hours[hour].messages += stub_counters.inbox_messages - before->inbox_messages;
+  s_hours[hour].message_bytes += stub_counters.inbox_bytes - before->inbox_bytes;
+  s_hours[hour].vibes += stub_counters.vibes - before->vibes;
+}
+
+// the ledger's hours against the tally: the hour that does not match, -1 if they all do
+static int ledger_mismatch(void) {
+  if (s_ledger_size < LEDGER_HEADER_SIZE || s_ledger[0] != LEDGER_PROTOCOL_VERSION) return 0;
+  int count = s_ledger[5];
+  if (count != LEDGER_HOURS || s_ledger_size != LEDGER_HEADER_SIZE + count * LEDGER_ENTRY_SIZE) return 0;
+
+  for (int i = 0; i < count; i++) {
+    const uint8_t *entry = &s_ledger[LEDGER_HEADER_SIZE + i * LEDGER_ENTRY_SIZE];
+    const HourTally *hour = &s_hours[DAY_HOURS + 1 - count + i];
+    if (entry[0] != hour->battery || (entry[1] | entry[2] << 8) != hour->frames || entry[3] != hour->messages ||
+        (entry[4] | entry[5] << 8) != hour->message_bytes || entry[6] != hour->vibes ||
+        entry[7] != hour->disconnects) {
+      return DAY_HOURS + 1 - count + i;
+    }
+  }
+  return -1;
+}
+
+// 24 hours from start, the same weather the slots ahead will bring
+static uint16_t pack_forecast(int slot, uint32_t start, uint8_t *data) {
+  data[0] = FORECAST_PROTOCOL_VERSION;
+  data[1] = start & 0xFF;
+  data[2] = (start >> 8) & 0xFF;
+  data[3] = (start >> 16) & 0xFF;
+  data[4] = start >> 24;
+  data[5] = WEATHER_UNIT_FAHRENHEIT;
+  data[6] = FORECAST_HOURS;
+  for (int i = 0; i < FORECAST_HOURS; i++) {
+    uint8_t *entry = &data[FORECAST_HEADER_SIZE + i * FORECAST_ENTRY_SIZE];
+    int hour_slot = slot + i * 2;
+    entry[0] = 50 + hour_slot % 7;
+    entry[1] = ICONS[hour_slot % 4];
+    entry[2] = CONDITIONS[hour_slot % 4];
+  }
+  return FORECAST_PAYLOAD_MAX;
+}
+
+// the phone's packed weather and forecast; settings go out until the watch has taken them once,
+// as PebbleKit JS sends every number: a 4-byte int32
+static void push_weather(int slot) {
+  uint8_t payload[WEATHER_PAYLOAD_SIZE];
+  weather_pack(&(WeatherReport) {
+    .temperature = 50 + slot % 7,
+    .unit = WEATHER_UNIT_FAHRENHEIT,
+    .icon = ICONS[slot % 4],
+    .condition = CONDITIONS[slot % 4],
+  }, payload);
+  uint8_t forecast[FORECAST_PAYLOAD_MAX];
+  time_t now = time(NULL);
+  uint16_t forecast_size = pack_forecast(slot, now - now % FORECAST_HOUR_S, forecast);
+
+  Tuplet tuplets[] = {
+    TupletBytes(WEATHER_KEY, payload, sizeof(payload)),
+    TupletBytes(FORECAST_KEY, forecast, forecast_size),
+    TupletInteger(INVERT_COLOR_KEY, (int32_t) 0),
+    TupletInteger(BLUETOOTHVIBE_KEY, (int32_t) 0),
+    TupletInteger(BLINK_KEY, (int32_t) 0),
+    TupletInteger(ANIMATION_KEY, (int32_t) ANIM_SETTING_AUTO),
+  };
+  if (stub_deliver_message(tuplets, s_settings_sent ? 2 : ARRAY_LENGTH(tuplets))) s_settings_sent = true;
+  s_answers++;
+}
+
+#define LOST_ANSWER_MINUTE 600
+#define BT_DOWN_MINUTE 780
+#define BT_UP_MINUTE 840
+
+static int s_minute = 0;
+static bool s_answer_lost = false;
+
+static void phone(const DictionaryIterator *sent) {
+  const Tuple *ledger = dict_find(sent, LEDGER_KEY);
+  if (ledger && ledger->length <= sizeof(s_ledger)) {
+    memcpy(s_ledger, ledger->value->data, ledger->length);
+    s_ledger_size = ledger->length;
+  }
+  if (!dict_find(sent, REQUEST_WEATHER_KEY)) return;
+
+  if (s_minute >= LOST_ANSWER_MINUTE && !s_answer_lost) {
+    s_answer_lost = true;
+    stub_drop_message();
+  } else {
+    push_weather(s_minute / 30);
+  }
+}
+
+// A report 40 minutes into a local hour, then the forecast's next hour: the face as it stands
+// just after that hour starts. The phone's forecast hours are local hours, so the face should
+// look the same in a timezone half an hour off UTC as in UTC.
+static uint32_t forecast_hour_hash(const char *tz) {
+  setenv("TZ", tz, 1);
+  tzset();
+  struct tm local = { .tm_year = 126, .tm_mon = 0, .tm_mday = 2, .tm_hour = 10, .tm_min = 40, .tm_isdst = -1 };
+  time_t start = mktime(&local);
+  stub_reset(start);
+  handle_init();
+  stub_advance(1000);
+
+  uint8_t payload[WEATHER_PAYLOAD_SIZE];
+  weather_pack(&(WeatherReport) {
+    .temperature = 40, .unit = WEATHER_UNIT_FAHRENHEIT, .icon = ICONS[3], .condition = CONDITIONS[3]
+  }, payload);
+  uint8_t forecast[FORECAST_PAYLOAD_MAX];
+  uint16_t forecast_size = pack_forecast(0, start - 40 * 60, forecast);
+  Tuplet tuplets[] = {
+    TupletBytes(WEATHER_KEY, payload, sizeof(payload)),
+    TupletBytes(FORECAST_KEY, forecast, forecast_size),
+  };
+  stub_deliver_message(tuplets, ARRAY_LENGTH(tuplets));
+  stub_advance(20 * 60 * 1000 + 5000);
+
+  uint32_t hash = stub_state_hash();
+  handle_deinit();
+  return hash;
+}
+
+int main(int argc, char **argv) {
+  setenv("TZ", "UTC", 1);
+  tzset();
+  stub_set_log_enabled(getenv("BENCH_LOG") != NULL);
+
+  // 2026-01-01 00:00:30 UTC, so the first tick lands 30 s in
+  stub_reset((time_t) 1767225630);
+  stub_set_phone(phone);
+
+  handle_init();
+  StubCounters first_frame = stub_counters; // what window_load loads before the first draw
+  stub_advance(5000);
+  StubCounters startup = stub_counters;
+
+  uint64_t min[METRIC_COUNT], max[METRIC_COUNT], total[METRIC_COUNT];
+  for (size_t m = 0; m < METRIC_COUNT; m++) {
+    min[m] = UINT64_MAX;
+    max[m] = 0;
+    total[m] = 0;
+  }
+
+  uint8_t battery = 100;
+  for (int minute = 0; minute < MINUTES_PER_DAY; minute++) {
+    StubCounters before = stub_counters;
+
+    // events at half past the minute count for this hour, the tick ending the step for its own
+    if (minute % 15 == 0 && battery > 5) {
+      stub_set_battery((BatteryChargeState) { --battery, false, false });
+    }
+    if (minute == BT_DOWN_MINUTE) {
+      stub_set_bluetooth(false);
+      s_hours[minute / 60].disconnects++;
+    }
+    if (minute == BT_UP_MINUTE) stub_set_bluetooth(true);
+    tally(minute / 60, &before);
+    StubCounters events = stub_counters;
+    if ((minute + 1) % 60 == 0) s_hours[(minute + 1) / 60].battery = battery;
+    s_minute = minute;
+    stub_advance(60000);
+    tally((minute + 1) / 60, &events);
+
+    for (size_t m = 0; m < METRIC_COUNT; m++) {
+      uint64_t delta = METRICS[m].read(&stub_counters) - METRICS[m].read(&before);
+      if (delta < min[m]) min[m] = delta;
+      if (delta > max[m]) max[m] = delta;
+      total[m] += delta;
+    }
+  }
+
+  uint32_t state_hash = stub_state_hash();
+  LinkStats link = *link_stats();
+  size_t heap_after_day = stub_counters.heap_used;
+  size_t heap_peak = stub_counters.heap_peak;
+
+  // the phone asks for the energy ledger; the request is the last message of the hour it covers
+  StubCounters before_export = stub_counters;
+  Tuplet ledger_request = TupletInteger(REQUEST_LEDGER_KEY, (uint32_t) 1);
+  stub_deliver_message(&ledger_request, 1);
+  stub_advance(1000);
+  tally(DAY_HOURS, &before_export);
+  int ledger_hour = ledger_mismatch();
+  handle_deinit();
+  size_t leaked = stub_counters.heap_used - stub_counters.message_buffers;
+
+  printf("first frame: %llu allocs, %u resource loads, heap %zu bytes\n",
+         (unsigned long long) first_frame.allocs, first_frame.resource_loads, first_frame.heap_used);
+  printf("startup: %llu allocs, %llu bytes, %u resource loads, heap %zu bytes\n",
+         (unsigned long long) startup.allocs, (unsigned long long) startup.alloc_bytes,
+         startup.resource_loads, startup.heap_used);
+  printf("\n%-22s %10s %10s %10s %12s\n", "per minute", "min", "avg", "max", "per day");
+  for (size_t m = 0; m < METRIC_COUNT; m++) {
+    printf("%-22s %10llu %10.1f %10llu %12llu\n", METRICS[m].name, (unsigned long long) min[m],
+           (double) total[m] / MINUTES_PER_DAY, (unsigned long long) max[m], (unsigned long long) total[m]);
+  }
+  printf("\nheap: %zu bytes after a day, %zu peak, %zu leaked at exit\n", heap_after_day, heap_peak, leaked);
+  // every answer the phone sent should have been taken in, the first with all the settings
+  bool answers_taken = link.received == s_answers;
+  printf("link: %u updates received of %u sent, %u failed, %u weather requests\n", link.received, s_answers,
+         link.failed, link.requests);
+  if (ledger_hour < 0) {
+    printf("ledger: %d hours exported in %u bytes, all matching the stub\n", s_ledger[5], s_ledger_size);
+  } else {
+    printf("ledger: hour %d of the day differs from the stub\n", ledger_hour);
+  }
+
+  // relaunch straight away: the first frame should already carry the day's last weather, so the
+  // face looks exactly as it did before the exit without waiting for the phone. Logging stays
+  // off, keeping the perf build's last summary the day's, unless BENCH_LOG_RELAUNCH asks for the
+  // trace of this second session: it starts from the day's persist storage.
+  stub_set_log_enabled(getenv("BENCH_LOG") != NULL && getenv("BENCH_LOG_RELAUNCH") != NULL);
+  stub_relaunch();
+  handle_init();
+  stub_advance(5000);
+  bool warm_start = stub_state_hash() == state_hash;
+  printf("warm start: %s (%u resource loads, %u persist reads)\n",
+         warm_start ? "restored" : "differs from the last frame",
+         stub_counters.resource_loads, stub_counters.persist_reads);
+
+  // seconds mode: with blink on, every second but a minute's first should only show or hide the
+  // separator, one small layer, without loading or allocating anything
+  Tuplet blink_on = TupletInteger(BLINK_KEY, (uint8_t) 1);
+  stub_deliver_message(&blink_on, 1);
+  stub_advance(1000);
+  bool seconds_cheap = true;
+  uint64_t second_min[SECOND_METRIC_COUNT], second_max[SECOND_METRIC_COUNT];
+  for (size_t m = 0; m < SECOND_METRIC_COUNT; m++) {
+    second_min[m] = UINT64_MAX;
+    second_max[m] = 0;
+  }
+  for (int second = 0; second < SECONDS_RUN; second++) {
+    StubCounters before = stub_counters;
+    stub_advance(1000);
+    if (time(NULL) % 60 == 0) continue; // the minute tick, as in the day
+
+    seconds_cheap = seconds_cheap && stub_counters.dirty_layers - before.dirty_layers == 1 &&
+                    stub_counters.allocs == before.allocs && stub_counters.resource_loads == before.resource_loads;
+    for (size_t m = 0; m < SECOND_METRIC_COUNT; m++) {
+      uint64_t delta = SECOND_METRICS[m].read(&stub_counters) - SECOND_METRICS[m].read(&before);
+      if (delta < second_min[m]) second_min[m] = delta;
+      if (delta > second_max[m]) second_max[m] = delta;
+    }
+  }
+  printf("\n%-22s %10s %10s\n", "seconds mode, a second", "min", "max");
+  for (size_t m = 0; m < SECOND_METRIC_COUNT; m++) {
+    printf("%-22s %10llu %10llu\n", SECOND_METRICS[m].name, (unsigned long long) second_min[m],
+           (unsigned long long) second_max[m]);
+  }
+  printf("seconds mode: %s\n", seconds_cheap ? "one layer per second" : "a second touches more than the separator");
+  uint32_t relaunch_hash = stub_state_hash();
+  handle_deinit();
+
+  bool forecast_local = forecast_hour_hash("Asia/Kolkata") == forecast_hour_hash("UTC");
+  printf("forecast hours: %s\n", forecast_local ? "local, in a half-hour timezone too" : "off in a half-hour timezone");
+
+  // one line for CI to diff
+  printf("\nBENCH");
+  for (size_t m = 0; m < METRIC_COUNT; m++) {
+    printf(" %s=%llu", METRICS[m].name, (unsigned long long) total[m]);
+  }
+  printf(" link_failed=%u link_requests=%u answers_taken=%d", link.failed, link.requests, answers_taken);
+  printf(" heap_peak=%zu leaked=%zu warm_start=%d seconds_cheap=%d ledger=%d forecast_local=%d state_hash=0x%08x"
+         " relaunch_hash=0x%08x\n", heap_peak, leaked, warm_start, seconds_cheap, ledger_hour < 0, forecast_local,
+         state_hash, relaunch_hash);
+
+  return leaked == 0 && warm_start && seconds_cheap && ledger_hour < 0 && answers_taken && forecast_local ? 0 : 1;
+}
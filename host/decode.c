@@ -0,0 +1,553 @@
+// Compares loading each image resource from its PNG with loading it from the raw blob
+// tools/rawbitmap.py makes of it, and picks the format per resource.
+//
+// The PNG path does what gbitmap_create_with_resource() does with a PNG: the file is read into
+// the heap, inflated into a buffer of filtered scanlines, unfiltered in place and converted into
+// a new bitmap of the platform's format. The raw path reads the header and then the pixels
+// straight into the bitmap's buffer. Both are timed over many loads and their peak heap is
+// measured through a counting allocator (zlib's state included); every PNG has to decode to the
+// blob byte for byte or the run fails. That check only keeps this decoder and rawbitmap.py in
+// step: both turn colour into aplite's 1 bit with the same rule (opaque and at least mid grey is
+// white), not with the firmware's own conversion. Host timings leave out flash reads, which is
+// why both file sizes are printed too.
+//
+// The pick keeps the resource pack from growing: raw wherever it loads faster and is no
+// bigger, then, out of the bytes that saves plus any budget given, the images that save the
+// most time per extra byte. The last line is the --raw-images option to build with; the same
+// list is written next to the manifest as raw-images.txt, which the option also takes as it is.
+//
+// Usage: decode <manifest from rawbitmap.py> [extra flash budget in bytes]
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#define ITERATIONS 200
+#define MAX_IMAGES 64
+#define BITMAP_HEADER_SIZE 12
+
+// GBitmapFormat values, as in the blobs
+enum { FORMAT_1BIT = 0, FORMAT_8BIT = 1, FORMAT_1BIT_PALETTE = 2 };
+
+typedef struct {
+  uint16_t row_size;
+  uint16_t info_flags;
+  int16_t width;
+  int16_t height;
+  uint8_t *data;      // rows, then the palette for palettized formats
+  size_t size;
+} Bitmap;
+
+typedef struct {
+  char family[8];     // "aplite" or "color"
+  char name[64];
+  char png_path[512];
+  char raw_path[512];
+  long png_bytes, raw_bytes;
+  double png_us, raw_us;
+  size_t png_peak, raw_peak;
+  bool raw;
+} Image;
+
+static Image s_images[MAX_IMAGES];
+static size_t s_image_count;
+
+// ---- counting heap
+
+static size_t s_heap_used, s_heap_peak;
+
+static void *heap_alloc(size_t size) {
+  size_t *block = malloc(sizeof(size_t) + size);
+  if (block == NULL) abort();
+  *block = size;
+  s_heap_used += size;
+  if (s_heap_used > s_heap_peak) s_heap_peak = s_heap_used;
+  return block + 1;
+}
+
+static void heap_free(void *ptr) {
+  if (ptr == NULL) return;
+  size_t *block = (size_t *) ptr - 1;
+  s_heap_used -= *block;
+  free(block);
+}
+
+static voidpf zlib_alloc(voidpf opaque, uInt items, uInt size) {
+  return heap_alloc((size_t) items * size);
+}
+
+static void zlib_free(voidpf opaque, voidpf ptr) {
+  heap_free(ptr);
+}
+
+// ---- loading
+
+static uint8_t *read_file(const char *path, long *length) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return NULL;
+  fseek(f, 0, SEEK_END);
+  *length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *data = heap_alloc((size_t) *length);
+  size_t got = fread(data, 1, (size_t) *length, f);
+  fclose(f);
+  if (got != (size_t) *length) {
+    heap_free(data);
+    return NULL;
+  }
+  return data;
+}
+
+static bool raw_load(const char *path, Bitmap *bitmap) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return false;
+  uint8_t header[BITMAP_HEADER_SIZE];
+  fseek(f, 0, SEEK_END);
+  long length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  bool ok = length > BITMAP_HEADER_SIZE && fread(header, 1, sizeof(header), f) == sizeof(header);
+  if (ok) {
+    bitmap->row_size = (uint16_t) (header[0] | header[1] << 8);
+    bitmap->info_flags = (uint16_t) (header[2] | header[3] << 8);
+    bitmap->width = (int16_t) (header[8] | header[9] << 8);
+    bitmap->height = (int16_t) (header[10] | header[11] << 8);
+    bitmap->size = (size_t) (length - BITMAP_HEADER_SIZE);
+    bitmap->data = heap_alloc(bitmap->size);
+    ok = fread(bitmap->data, 1, bitmap->size, f) == bitmap->size;
+  }
+  fclose(f);
+  return ok;
+}
+
+static uint32_t be32(const uint8_t *p) {
+  return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static uint8_t paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if (pa <= pb && pa <= pc) return (uint8_t) a;
+  return (uint8_t) (pb <= pc ? b : c);
+}
+
+static void unfilter(uint8_t *raw, uint32_t height, uint32_t stride, uint32_t bpp) {
+  const uint8_t *prev = NULL;
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t type = raw[y * (stride + 1)];
+    uint8_t *row = raw + y * (stride + 1) + 1;
+    for (uint32_t i = 0; i < stride; i++) {
+      int left = i >= bpp ? row[i - bpp] : 0;
+      int up = prev ? prev[i] : 0;
+      int upleft = prev && i >= bpp ? prev[i - bpp] : 0;
+      switch (type) {
+        case 1: row[i] += left; break;
+        case 2: row[i] += up; break;
+        case 3: row[i] += (left + up) >> 1; break;
+        case 4: row[i] += paeth(left, up, upleft); break;
+      }
+    }
+    prev = row;
+  }
+}
+
+// two bits each of alpha, red, green and blue: the top two, as GColorFromRGBA keeps them
+static uint8_t gcolor8(const uint8_t rgba[4]) {
+  if (rgba[3] >> 6 == 0) return 0;
+  return (uint8_t) ((rgba[3] >> 6) << 6 | (rgba[0] >> 6) << 4 | (rgba[1] >> 6) << 2 | rgba[2] >> 6);
+}
+
+typedef struct {
+  uint32_t width, height;
+  uint8_t depth, color_type;
+  bool interlaced;
+  const uint8_t *palette;  // PLTE
+  uint32_t palette_count;
+  const uint8_t *alpha;    // tRNS
+  uint32_t alpha_count;
+} PngFormat;
+
+// Adam7 passes: x start, y start, x step, y step; the last one alone is a plain image
+static const uint8_t PASSES[8][4] = {
+  { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+  { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 }, { 0, 0, 1, 1 },
+};
+
+static uint32_t sample_at(const PngFormat *png, const uint8_t *row, uint32_t x) {
+  if (png->depth == 8) return row[x];
+  uint32_t bit = x * png->depth;
+  return (row[bit / 8] >> (8 - png->depth - bit % 8)) & ((1u << png->depth) - 1);
+}
+
+static void pixel(const PngFormat *png, const uint8_t *row, uint32_t x, uint8_t rgba[4]) {
+  switch (png->color_type) {
+    case 0: {  // grey
+      uint8_t grey = (uint8_t) (sample_at(png, row, x) * (255 / ((1u << png->depth) - 1)));
+      rgba[0] = rgba[1] = rgba[2] = grey;
+      rgba[3] = 255;
+      break;
+    }
+    case 3: {  // palette
+      uint32_t index = sample_at(png, row, x);
+      if (index < png->palette_count) memcpy(rgba, png->palette + 3 * index, 3);
+      else memset(rgba, 0, 3);
+      rgba[3] = index < png->alpha_count ? png->alpha[index] : 255;
+      break;
+    }
+    case 2: memcpy(rgba, row + 3 * x, 3); rgba[3] = 255; break;
+    case 4: rgba[0] = rgba[1] = rgba[2] = row[2 * x]; rgba[3] = row[2 * x + 1]; break;
+    default: memcpy(rgba, row + 4 * x, 4); break;
+  }
+}
+
+static uint8_t bitmap_format(const Bitmap *bitmap) {
+  return (bitmap->info_flags >> 1) & 0x1F;
+}
+
+// allocates the bitmap the family's firmware makes of the PNG, palette filled in
+static void bitmap_init(Bitmap *bitmap, const PngFormat *png, bool aplite) {
+  uint8_t format;
+  if (aplite) {
+    format = FORMAT_1BIT;
+    bitmap->row_size = (uint16_t) ((png->width + 31) / 32 * 4);
+  } else if (png->color_type == 3 && png->depth < 8) {
+    format = (uint8_t) (FORMAT_1BIT_PALETTE + (png->depth == 1 ? 0 : png->depth == 2 ? 1 : 2));
+    bitmap->row_size = (uint16_t) ((png->width * png->depth + 7) / 8);
+  } else {
+    format = FORMAT_8BIT;
+    bitmap->row_size = (uint16_t) png->width;
+  }
+  size_t palette_size = format >= FORMAT_1BIT_PALETTE ? 1u << png->depth : 0;
+  bitmap->info_flags = (uint16_t) (format << 1 | 1 << 12);
+  bitmap->width = (int16_t) png->width;
+  bitmap->height = (int16_t) png->height;
+  bitmap->size = (size_t) bitmap->row_size * png->height + palette_size;
+  bitmap->data = heap_alloc(bitmap->size);
+  memset(bitmap->data, 0, bitmap->size);
+
+  uint8_t *colors = bitmap->data + (size_t) bitmap->row_size * png->height;
+  for (size_t i = 0; i < palette_size; i++) {
+    uint8_t rgba[4] = { 0, 0, 0, 0 };
+    if (i < png->palette_count) {
+      memcpy(rgba, png->palette + 3 * i, 3);
+      rgba[3] = i < png->alpha_count ? png->alpha[i] : 255;
+    }
+    colors[i] = gcolor8(rgba);
+  }
+}
+
+// pixel sx of a PNG row to (x, y) of the bitmap
+static void put(Bitmap *bitmap, const PngFormat *png, const uint8_t *row, uint32_t sx,
+                uint32_t x, uint32_t y) {
+  uint8_t *out = bitmap->data + (size_t) y * bitmap->row_size;
+  uint8_t format = bitmap_format(bitmap);
+  if (format >= FORMAT_1BIT_PALETTE) {
+    uint32_t bit = x * png->depth;
+    out[bit / 8] |= (uint8_t) (sample_at(png, row, sx) << (8 - png->depth - bit % 8));
+    return;
+  }
+  uint8_t rgba[4];
+  pixel(png, row, sx, rgba);
+  if (format == FORMAT_8BIT) {
+    out[x] = gcolor8(rgba);
+  } else if (rgba[3] >= 128 && rgba[0] + rgba[1] + rgba[2] >= 3 * 128) {
+    out[x / 8] |= (uint8_t) (1 << (x % 8));
+  }
+}
+
+static bool png_load(const char *path, bool aplite, Bitmap *bitmap) {
+  long length;
+  uint8_t *file = read_file(path, &length);
+  if (file == NULL || length < 8 || memcmp(file, "\x89PNG\r\n\x1a\n", 8) != 0) {
+    heap_free(file);
+    return false;
+  }
+
+  PngFormat png = { 0 };
+  const uint8_t *idat = NULL;
+  uint32_t idat_length = 0, idat_count = 0;
+  for (long pos = 8; pos + 12 <= length;) {
+    uint32_t chunk = be32(file + pos);
+    const uint8_t *tag = file + pos + 4, *body = file + pos + 8;
+    if (!memcmp(tag, "IHDR", 4)) {
+      png.width = be32(body);
+      png.height = be32(body + 4);
+      png.depth = body[8];
+      png.color_type = body[9];
+      png.interlaced = body[12] != 0;
+    } else if (!memcmp(tag, "PLTE", 4)) {
+      png.palette = body;
+      png.palette_count = chunk / 3;
+    } else if (!memcmp(tag, "tRNS", 4)) {
+      png.alpha = body;
+      png.alpha_count = chunk;
+    } else if (!memcmp(tag, "IDAT", 4)) {
+      if (idat_count++ == 0) idat = body;
+      idat_length += chunk;
+    }
+    pos += 12 + (long) chunk;
+  }
+  if (png.depth > 8 || png.color_type > 6) {  // 16 bit: not what the resources use
+    heap_free(file);
+    return false;
+  }
+
+  // split image data has to be joined before it can be inflated in one go
+  uint8_t *joined = NULL;
+  if (idat_count > 1) {
+    joined = heap_alloc(idat_length);
+    uint32_t at = 0;
+    for (long pos = 8; pos + 12 <= length; pos += 12 + (long) be32(file + pos)) {
+      if (memcmp(file + pos + 4, "IDAT", 4)) continue;
+      memcpy(joined + at, file + pos + 8, be32(file + pos));
+      at += be32(file + pos);
+    }
+    idat = joined;
+  }
+
+  static const uint8_t CHANNELS[] = { 1, 0, 3, 1, 2, 0, 4 };
+  uint32_t bits = (uint32_t) CHANNELS[png.color_type] * png.depth;
+  uint32_t bpp = bits >= 8 ? bits / 8 : 1;
+  size_t first_pass = png.interlaced ? 0 : 7, end_pass = png.interlaced ? 7 : 8;
+  size_t raw_size = 0;
+  for (size_t p = first_pass; p < end_pass; p++) {
+    uint32_t w = (png.width - PASSES[p][0] + PASSES[p][2] - 1) / PASSES[p][2];
+    uint32_t h = (png.height - PASSES[p][1] + PASSES[p][3] - 1) / PASSES[p][3];
+    if (png.width > PASSES[p][0] && png.height > PASSES[p][1]) raw_size += (size_t) ((w * bits + 7) / 8 + 1) * h;
+  }
+  uint8_t *raw = heap_alloc(raw_size);
+
+  z_stream stream = { .zalloc = zlib_alloc, .zfree = zlib_free };
+  bool ok = inflateInit(&stream) == Z_OK;
+  if (ok) {
+    stream.next_in = (Bytef *) idat;
+    stream.avail_in = idat_length;
+    stream.next_out = raw;
+    stream.avail_out = (uInt) raw_size;
+    ok = inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.avail_out == 0;
+    inflateEnd(&stream);
+  }
+  if (ok) {
+    bitmap_init(bitmap, &png, aplite);
+    uint8_t *pass = raw;
+    for (size_t p = first_pass; p < end_pass; p++) {
+      if (png.width <= PASSES[p][0] || png.height <= PASSES[p][1]) continue;
+      uint32_t w = (png.width - PASSES[p][0] + PASSES[p][2] - 1) / PASSES[p][2];
+      uint32_t h = (png.height - PASSES[p][1] + PASSES[p][3] - 1) / PASSES[p][3];
+      uint32_t stride = (w * bits + 7) / 8;
+      unfilter(pass, h, stride, bpp);
+      for (uint32_t j = 0; j < h; j++) {
+        const uint8_t *row = pass + j * (stride + 1) + 1;
+        uint32_t y = PASSES[p][1] + j * PASSES[p][3];
+        if (!png.interlaced && bitmap_format(bitmap) >= FORMAT_1BIT_PALETTE) {
+          // same layout as the bitmap's rows
+          memcpy(bitmap->data + (size_t) y * bitmap->row_size, row, stride);
+          continue;
+        }
+        for (uint32_t i = 0; i < w; i++) {
+          put(bitmap, &png, row, i, PASSES[p][0] + i * PASSES[p][2], y);
+        }
+      }
+      pass += (size_t) (stride + 1) * h;
+    }
+  }
+  heap_free(raw);
+  heap_free(joined);
+  heap_free(file);
+  return ok;
+}
+
+// ---- measuring
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static bool measure(Image *image) {
+  bool aplite = !strcmp(image->family, "aplite");
+  Bitmap decoded, stored;
+
+  size_t base = s_heap_peak = s_heap_used;
+  if (!png_load(image->png_path, aplite, &decoded)) {
+    fprintf(stderr, "%s: cannot decode %s\n", image->name, image->png_path);
+    return false;
+  }
+  image->png_peak = s_heap_peak - base;
+  base = s_heap_peak = s_heap_used;
+  if (!raw_load(image->raw_path, &stored)) {
+    fprintf(stderr, "%s: cannot read %s\n", image->name, image->raw_path);
+    return false;
+  }
+  image->raw_peak = s_heap_peak - base;
+
+  bool same = decoded.row_size == stored.row_size && decoded.info_flags == stored.info_flags &&
+              decoded.width == stored.width && decoded.height == stored.height &&
+              decoded.size == stored.size && !memcmp(decoded.data, stored.data, decoded.size);
+  heap_free(decoded.data);
+  heap_free(stored.data);
+  if (!same) {
+    fprintf(stderr, "%s: %s does not decode to %s\n", image->name, image->png_path, image->raw_path);
+    return false;
+  }
+
+  double start = now_us();
+  for (int i = 0; i < ITERATIONS; i++) {
+    png_load(image->png_path, aplite, &decoded);
+    heap_free(decoded.data);
+  }
+  image->png_us = (now_us() - start) / ITERATIONS;
+  start = now_us();
+  for (int i = 0; i < ITERATIONS; i++) {
+    raw_load(image->raw_path, &stored);
+    heap_free(stored.data);
+  }
+  image->raw_us = (now_us() - start) / ITERATIONS;
+  return true;
+}
+
+static int by_time_per_byte(const void *a, const void *b) {
+  const Image *x = *(Image *const *) a, *y = *(Image *const *) b;
+  double vx = (x->png_us - x->raw_us) / (double) (x->raw_bytes - x->png_bytes);
+  double vy = (y->png_us - y->raw_us) / (double) (y->raw_bytes - y->png_bytes);
+  return vx < vy ? 1 : vx > vy ? -1 : 0;
+}
+
+// marks the family's images to store raw; returns how much the resource pack grows
+static long pick(const char *family, long budget) {
+  Image *growing[MAX_IMAGES];
+  size_t growing_count = 0;
+  long growth = 0;
+  for (size_t i = 0; i < s_image_count; i++) {
+    Image *image = &s_images[i];
+    if (strcmp(image->family, family) || image->raw_us >= image->png_us) continue;
+    if (image->raw_bytes <= image->png_bytes) {
+      image->raw = true;
+      growth += image->raw_bytes - image->png_bytes;
+    } else {
+      growing[growing_count++] = image;
+    }
+  }
+  qsort(growing, growing_count, sizeof(growing[0]), by_time_per_byte);
+  for (size_t i = 0; i < growing_count; i++) {
+    long extra = growing[i]->raw_bytes - growing[i]->png_bytes;
+    if (growth + extra > budget) continue;
+    growing[i]->raw = true;
+    growth += extra;
+  }
+  return growth;
+}
+
+static void report(const char *family, long growth) {
+  printf("\n%-20s %7s %7s %9s %9s %9s %9s  %s\n", family, "png B", "raw B", "png us", "raw us",
+         "png peak", "raw peak", "pick");
+  long png_bytes = 0, raw_bytes = 0;
+  double png_us = 0, raw_us = 0, picked_us = 0;
+  size_t png_peak = 0, raw_peak = 0;
+  for (size_t i = 0; i < s_image_count; i++) {
+    const Image *image = &s_images[i];
+    if (strcmp(image->family, family)) continue;
+    printf("%-20s %7ld %7ld %9.2f %9.2f %9zu %9zu  %s\n", image->name, image->png_bytes,
+           image->raw_bytes, image->png_us, image->raw_us, image->png_peak, image->raw_peak,
+           image->raw ? "raw" : "png");
+    png_bytes += image->png_bytes;
+    raw_bytes += image->raw_bytes;
+    png_us += image->png_us;
+    raw_us += image->raw_us;
+    picked_us += image->raw ? image->raw_us : image->png_us;
+    if (image->png_peak > png_peak) png_peak = image->png_peak;
+    if (image->raw_peak > raw_peak) raw_peak = image->raw_peak;
+  }
+  printf("%-20s %7ld %7ld %9.2f %9.2f %9zu %9zu\n", "all (peak: largest)", png_bytes, raw_bytes,
+         png_us, raw_us, png_peak, raw_peak);
+  printf("picked: %.2f us to load everything once, resource pack %+ld bytes\n", picked_us, growth);
+}
+
+static bool targeted(const char *targets, const char *family) {
+  char word[16];
+  snprintf(word, sizeof(word), " %.8s ", family);
+  return strstr(targets, word) != NULL;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <manifest> [extra flash budget]\n", argv[0]);
+    return 2;
+  }
+  long budget = argc > 2 ? atol(argv[2]) : 0;
+  FILE *manifest = fopen(argv[1], "r");
+  if (manifest == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  char targets[64] = "";
+  char line[1200];
+  while (fgets(line, sizeof(line), manifest)) {
+    if (!strncmp(line, "targets ", 8)) {
+      snprintf(targets, sizeof(targets), " %.60s", line + 8);
+      targets[strcspn(targets, "\n")] = ' ';
+      continue;
+    }
+    if (s_image_count == MAX_IMAGES) break;
+    Image *image = &s_images[s_image_count];
+    if (sscanf(line, "%7s %63s %511s %511s", image->family, image->name, image->png_path,
+               image->raw_path) != 4) continue;
+    s_image_count++;
+  }
+  fclose(manifest);
+
+  for (size_t i = 0; i < s_image_count; i++) {
+    Image *image = &s_images[i];
+    long length;
+    uint8_t *data = read_file(image->png_path, &length);
+    image->png_bytes = length;
+    heap_free(data);
+    data = read_file(image->raw_path, &length);
+    image->raw_bytes = length;
+    heap_free(data);
+    if (!measure(image)) return 1;
+  }
+
+  static const char *const FAMILIES[] = { "aplite", "color" };
+  for (size_t f = 0; f < 2; f++) {
+    report(FAMILIES[f], pick(FAMILIES[f], budget));
+  }
+
+  // a resource has one type on every platform the app targets
+  char picked_path[600];
+  const char *slash = strrchr(argv[1], '/');
+  snprintf(picked_path, sizeof(picked_path), "%.*sraw-images.txt",
+           slash ? (int) (slash - argv[1] + 1) : 0, argv[1]);
+  FILE *picked = fopen(picked_path, "w");
+  if (picked == NULL) {
+    perror(picked_path);
+    return 1;
+  }
+  char names[MAX_IMAGES * 64] = "";
+  for (size_t i = 0; i < s_image_count; i++) {
+    const Image *image = &s_images[i];
+    if (!targeted(targets, image->family)) continue;
+    bool everywhere = true, repeated = false;
+    for (size_t j = 0; j < s_image_count; j++) {
+      const Image *other = &s_images[j];
+      if (strcmp(other->name, image->name) || !targeted(targets, other->family)) continue;
+      repeated = repeated || j < i;
+      everywhere = everywhere && other->raw;
+    }
+    if (repeated || !everywhere) continue;
+    if (names[0]) strcat(names, ",");
+    strcat(names, image->name);
+  }
+  fprintf(picked, "%s\n", names);
+  fclose(picked);
+  if (names[0]) {
+    printf("\nbuild with: --raw-images=%s\n", names);
+  } else {
+    printf("\nraw pays for nothing: build with PNGs as they are\n");
+  }
+  return 0;
+}
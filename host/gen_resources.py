@@ -0,0 +1,49 @@
+"""Emit the resource id header and resource table for the host build.
+
+Mirrors what the Pebble SDK generates from appinfo.json, plus the image
+sizes and file lengths the stub needs to account for bitmap and font
+loads. Usage: gen_resources.py <appinfo.json> <out dir>
+"""
+
+import json
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'tools'))
+import pngio
+
+KINDS = {'png': 'STUB_RESOURCE_BITMAP', 'font': 'STUB_RESOURCE_FONT'}
+
+
+def main(appinfo_path, out_dir):
+    root = os.path.dirname(os.path.abspath(appinfo_path))
+    with open(appinfo_path) as f:
+        media = json.load(f)['resources']['media']
+
+    ids = []
+    rows = []
+    for index, entry in enumerate(media, 1):
+        path = os.path.join('resources', entry['file'])
+        full = os.path.join(root, path)
+        width = height = 0
+        if entry['type'] == 'png':
+            width, height = pngio.size(full)
+        ids.append('  RESOURCE_ID_%s = %d,' % (entry['name'], index))
+        rows.append('  { %d, "%s", %s, "%s", %d, %d, %d },' % (
+            index, entry['name'], KINDS.get(entry['type'], 'STUB_RESOURCE_RAW'),
+            path, width, height, os.path.getsize(full)))
+
+    with open(os.path.join(out_dir, 'resource_ids.auto.h'), 'w') as f:
+        f.write('// Generated by host/gen_resources.py -- do not edit.\n#pragma once\n\n')
+        f.write('enum {\n  RESOURCE_ID_INVALID = 0,\n%s\n};\n' % '\n'.join(ids))
+
+    with open(os.path.join(out_dir, 'resources.auto.c'), 'w') as f:
+        f.write('// Generated by host/gen_resources.py -- do not edit.\n')
+        f.write('#include "stub_resources.h"\n\n')
+        f.write('const StubResource STUB_RESOURCES[] = {\n%s\n};\n\n' % '\n'.join(rows))
+        f.write('const size_t STUB_RESOURCE_COUNT = %d;\n' % len(rows))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1], sys.argv[2])
@@ -0,0 +1,541 @@
+// Host-side stand-in for the Pebble SDK header, just enough of it to build src/*.c on Linux.
+// Everything lives in memory and is counted, see pebble_stub.h. Behaves like aplite: black and
+// white, animations are not destroyed when they stop.
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <locale.h>
+
+#include "resource_ids.auto.h"
+
+#ifndef PBL_PLATFORM_APLITE
+#define PBL_PLATFORM_APLITE
+#endif
+#ifndef PBL_BW
+#define PBL_BW
+#endif
+
+#define ARRAY_LENGTH(array) (sizeof((array)) / sizeof((array)[0]))
+
+// ---- heap: the app heap is what we are measuring, so every allocation is routed through it
+
+void *stub_malloc(size_t size);
+void *stub_calloc(size_t count, size_t size);
+void *stub_realloc(void *ptr, size_t size);
+void stub_free(void *ptr);
+
+#define malloc(size) stub_malloc(size)
+#define calloc(count, size) stub_calloc(count, size)
+#define realloc(ptr, size) stub_realloc(ptr, size)
+#define free(ptr) stub_free(ptr)
+
+size_t heap_bytes_used(void);
+size_t heap_bytes_free(void);
+
+// ---- logging
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+  APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...);
+
+#define APP_LOG(level, fmt, ...) app_log(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+
+// ---- geometry and graphics
+
+typedef struct GPoint {
+  int16_t x;
+  int16_t y;
+} GPoint;
+
+typedef struct GSize {
+  int16_t w;
+  int16_t h;
+} GSize;
+
+typedef struct GRect {
+  GPoint origin;
+  GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint){ (x), (y) })
+#define GSize(w, h) ((GSize){ (w), (h) })
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+#define GPointZero GPoint(0, 0)
+#define GRectZero GRect(0, 0, 0, 0)
+
+bool grect_equal(const GRect *rect_a, const GRect *rect_b);
+bool gpoint_equal(const GPoint *point_a, const GPoint *point_b);
+
+typedef enum GColor {
+  GColorClear = ~0,
+  GColorBlack = 0,
+  GColorWhite = 1,
+} GColor;
+
+typedef enum {
+  GCompOpAssign,
+  GCompOpAssignInverted,
+  GCompOpOr,
+  GCompOpAnd,
+  GCompOpClear,
+  GCompOpSet,
+} GCompOp;
+
+typedef enum {
+  GTextAlignmentLeft,
+  GTextAlignmentCenter,
+  GTextAlignmentRight,
+} GTextAlignment;
+
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef enum {
+  GAlignCenter,
+  GAlignTopLeft,
+  GAlignTopRight,
+  GAlignTop,
+  GAlignLeft,
+  GAlignBottom,
+  GAlignRight,
+  GAlignBottomRight,
+  GAlignBottomLeft,
+} GAlign;
+
+// the SDK 2 layout, which src/main.c reads directly on aplite
+typedef struct GBitmap {
+  void *addr;
+  uint16_t row_size_bytes;
+  uint16_t info_flags;
+  GRect bounds;
+  struct GBitmap *parent; // sub-bitmaps share their parent's pixels
+  size_t heap_bytes;
+  uint32_t resource_id;   // 0 for blank bitmaps
+} GBitmap;
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+GBitmap *gbitmap_create_blank(GSize size);
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect);
+void gbitmap_destroy(GBitmap *bitmap);
+#ifndef PBL_PLATFORM_APLITE
+// SDK 3 accessors; aplite code reads and writes the struct, so the host build leaves them out
+GRect gbitmap_get_bounds(const GBitmap *bitmap);
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds);
+#endif
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+
+typedef struct GContext GContext;
+
+typedef struct GFontStub *GFont;
+
+#define FONT_KEY_GOTHIC_14 "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_18 "RESOURCE_ID_GOTHIC_18"
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+#define FONT_KEY_GOTHIC_28_BOLD "RESOURCE_ID_GOTHIC_28_BOLD"
+
+typedef struct ResHandleStub *ResHandle;
+
+ResHandle resource_get_handle(uint32_t resource_id);
+size_t resource_size(ResHandle h);
+size_t resource_load(ResHandle h, uint8_t *buffer, size_t max_length);
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes);
+
+GFont fonts_get_system_font(const char *font_key);
+GFont fonts_load_custom_font(ResHandle handle);
+void fonts_unload_custom_font(GFont font);
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, int corner_mask);
+void graphics_draw_rect(GContext *ctx, GRect rect);
+void graphics_draw_pixel(GContext *ctx, GPoint point);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        void *text_attributes);
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment);
+
+#define GCornerNone 0
+
+// ---- layers
+
+typedef struct Layer Layer;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+Layer *layer_create_with_data(GRect frame, size_t data_size);
+void layer_destroy(Layer *layer);
+void *layer_get_data(const Layer *layer);
+void layer_mark_dirty(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_set_frame(Layer *layer, GRect frame);
+GRect layer_get_frame(const Layer *layer);
+void layer_set_bounds(Layer *layer, GRect bounds);
+GRect layer_get_bounds(const Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_remove_from_parent(Layer *child);
+void layer_set_hidden(Layer *layer, bool hidden);
+bool layer_get_hidden(const Layer *layer);
+void layer_set_clips(Layer *layer, bool clips);
+
+typedef struct BitmapLayer BitmapLayer;
+
+BitmapLayer *bitmap_layer_create(GRect frame);
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer);
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer);
+const GBitmap *bitmap_layer_get_bitmap(BitmapLayer *bitmap_layer);
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap);
+void bitmap_layer_set_alignment(BitmapLayer *bitmap_layer, GAlign alignment);
+void bitmap_layer_set_background_color(BitmapLayer *bitmap_layer, GColor color);
+void bitmap_layer_set_compositing_mode(BitmapLayer *bitmap_layer, GCompOp mode);
+
+typedef struct TextLayer TextLayer;
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+const char *text_layer_get_text(TextLayer *text_layer);
+void text_layer_set_background_color(TextLayer *text_layer, GColor color);
+void text_layer_set_text_color(TextLayer *text_layer, GColor color);
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode);
+
+typedef struct InverterLayer InverterLayer;
+
+InverterLayer *inverter_layer_create(GRect frame);
+void inverter_layer_destroy(InverterLayer *inverter_layer);
+Layer *inverter_layer_get_layer(InverterLayer *inverter_layer);
+
+// ---- windows
+
+typedef struct Window Window;
+typedef void (*WindowHandler)(Window *window);
+
+typedef struct WindowHandlers {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_background_color(Window *window, GColor background_color);
+Layer *window_get_root_layer(const Window *window);
+void window_stack_push(Window *window, bool animated);
+Window *window_stack_remove(Window *window, bool animated);
+
+// ---- animation
+
+typedef struct Animation Animation;
+typedef struct PropertyAnimation PropertyAnimation;
+
+#ifndef PBL_PLATFORM_APLITE
+typedef uint32_t AnimationProgress;
+#endif
+#define ANIMATION_NORMALIZED_MIN 0
+#define ANIMATION_NORMALIZED_MAX 65535
+
+typedef enum {
+  AnimationCurveLinear = 0,
+  AnimationCurveEaseIn = 1,
+  AnimationCurveEaseOut = 2,
+  AnimationCurveEaseInOut = 3,
+} AnimationCurve;
+
+typedef void (*AnimationStartedHandler)(Animation *animation, void *context);
+typedef void (*AnimationStoppedHandler)(Animation *animation, bool finished, void *context);
+
+typedef struct AnimationHandlers {
+  AnimationStartedHandler started;
+  AnimationStoppedHandler stopped;
+} AnimationHandlers;
+
+typedef void (*AnimationSetupImplementation)(Animation *animation);
+#ifdef PBL_PLATFORM_APLITE
+// SDK 2: the update gets the normalized time, there is no AnimationProgress
+typedef void (*AnimationUpdateImplementation)(Animation *animation, const uint32_t time_normalized);
+#else
+typedef void (*AnimationUpdateImplementation)(Animation *animation, const AnimationProgress progress);
+#endif
+typedef void (*AnimationTeardownImplementation)(Animation *animation);
+
+typedef struct AnimationImplementation {
+  AnimationSetupImplementation setup;
+  AnimationUpdateImplementation update;
+  AnimationTeardownImplementation teardown;
+} AnimationImplementation;
+
+Animation *animation_create(void);
+bool animation_destroy(Animation *animation);
+bool animation_set_implementation(Animation *animation, const AnimationImplementation *implementation);
+bool animation_set_handlers(Animation *animation, AnimationHandlers callbacks, void *context);
+void *animation_get_context(Animation *animation);
+bool animation_set_curve(Animation *animation, AnimationCurve curve);
+bool animation_set_duration(Animation *animation, uint32_t duration_ms);
+bool animation_set_delay(Animation *animation, uint32_t delay_ms);
+bool animation_schedule(Animation *animation);
+bool animation_unschedule(Animation *animation);
+bool animation_is_scheduled(Animation *animation);
+
+PropertyAnimation *property_animation_create_layer_frame(Layer *layer, GRect *from_frame, GRect *to_frame);
+void property_animation_destroy(PropertyAnimation *property_animation);
+
+// ---- timers and time
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+// wall clock follows the stub's virtual time, see stub_advance()
+time_t stub_time(time_t *tloc);
+#define time(tloc) stub_time(tloc)
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+bool clock_is_24h_style(void);
+
+typedef enum {
+  SECOND_UNIT = 1 << 0,
+  MINUTE_UNIT = 1 << 1,
+  HOUR_UNIT = 1 << 2,
+  DAY_UNIT = 1 << 3,
+  MONTH_UNIT = 1 << 4,
+  YEAR_UNIT = 1 << 5,
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+// ---- system services
+
+typedef struct {
+  uint8_t charge_percent;
+  bool is_charging;
+  bool is_plugged;
+} BatteryChargeState;
+
+typedef void (*BatteryStateHandler)(BatteryChargeState charge);
+
+void battery_state_service_subscribe(BatteryStateHandler handler);
+void battery_state_service_unsubscribe(void);
+BatteryChargeState battery_state_service_peek(void);
+
+typedef void (*BluetoothConnectionHandler)(bool connected);
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler);
+void bluetooth_connection_service_unsubscribe(void);
+bool bluetooth_connection_service_peek(void);
+
+void vibes_short_pulse(void);
+void vibes_long_pulse(void);
+void vibes_double_pulse(void);
+
+void app_event_loop(void);
+
+// ---- persistent storage
+
+#define PERSIST_DATA_MAX_LENGTH 256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+typedef enum {
+  S_SUCCESS = 0,
+  E_ERROR = -1,
+  E_INVALID_ARGUMENT = -3,
+  E_DOES_NOT_EXIST = -10,
+  E_OUT_OF_STORAGE = -11,
+} StatusCode;
+
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+bool persist_read_bool(const uint32_t key);
+int32_t persist_read_int(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size);
+typedef int32_t status_t;
+
+status_t persist_write_bool(const uint32_t key, const bool value);
+status_t persist_write_int(const uint32_t key, const int32_t value);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+int persist_write_string(const uint32_t key, const char *cstring);
+status_t persist_delete(const uint32_t key);
+
+// ---- dictionaries, AppMessage and AppSync
+
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    char cstring[0];
+    uint8_t uint8;
+    uint16_t uint16;
+    uint32_t uint32;
+    int8_t int8;
+    int16_t int16;
+    int32_t int32;
+  } value[];
+} Tuple;
+
+typedef struct Tuplet {
+  TupleType type;
+  uint32_t key;
+  union {
+    struct {
+      const uint8_t *data;
+      const uint16_t length;
+    } bytes;
+    struct {
+      const char *data;
+      const uint16_t length;
+    } cstring;
+    struct {
+      uint32_t storage;
+      const uint16_t width;
+    } integer;
+  };
+} Tuplet;
+
+#define TupletBytes(_key, _data, _length) \
+  ((const Tuplet) { .type = TUPLE_BYTE_ARRAY, .key = _key, .bytes = { .data = _data, .length = _length } })
+#define TupletCString(_key, _cstring) \
+  ((const Tuplet) { .type = TUPLE_CSTRING, .key = _key, .cstring = { .data = _cstring, .length = _cstring ? strlen(_cstring) + 1 : 0 } })
+#define TupletInteger(_key, _integer) \
+  ((const Tuplet) { .type = _Generic((_integer), uint8_t: TUPLE_UINT, uint16_t: TUPLE_UINT, uint32_t: TUPLE_UINT, default: TUPLE_INT), \
+                    .key = _key, .integer = { .storage = (uint32_t) (_integer), .width = sizeof(_integer) } })
+
+typedef struct {
+  uint8_t count;
+  Tuple head[];
+} Dictionary;
+
+typedef struct {
+  Dictionary *dictionary;
+  const uint8_t *end;
+  Tuple *cursor;
+} DictionaryIterator;
+
+typedef enum {
+  DICT_OK = 0,
+  DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+  DICT_INVALID_ARGS = 1 << 2,
+  DICT_INTERNAL_INCONSISTENCY = 1 << 3,
+  DICT_MALLOC_FAILED = 1 << 4,
+} DictionaryResult;
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...);
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *const buffer, const uint16_t size);
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet *const tuplet);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *const data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *const cstring);
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value);
+uint32_t dict_write_end(DictionaryIterator *iter);
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *const buffer, const uint16_t size);
+Tuple *dict_read_first(DictionaryIterator *iter);
+Tuple *dict_read_next(DictionaryIterator *iter);
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+typedef enum {
+  APP_MSG_OK = 0,
+  APP_MSG_SEND_TIMEOUT = 1 << 1,
+  APP_MSG_SEND_REJECTED = 1 << 2,
+  APP_MSG_NOT_CONNECTED = 1 << 3,
+  APP_MSG_APP_NOT_RUNNING = 1 << 4,
+  APP_MSG_INVALID_ARGS = 1 << 5,
+  APP_MSG_BUSY = 1 << 6,
+  APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+  APP_MSG_ALREADY_RELEASED = 1 << 9,
+  APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+  APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+  APP_MSG_OUT_OF_MEMORY = 1 << 12,
+  APP_MSG_CLOSED = 1 << 13,
+  APP_MSG_INTERNAL_ERROR = 1 << 14,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason, void *context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator, AppMessageResult reason, void *context);
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+void *app_message_get_context(void);
+void *app_message_set_context(void *context);
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback);
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback);
+void app_message_deregister_callbacks(void);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+typedef enum {
+  APP_SYNC_OK = 0,
+  APP_SYNC_DICT_NOT_ENOUGH_STORAGE = DICT_NOT_ENOUGH_STORAGE,
+} AppSyncErrorValues;
+
+typedef int AppSyncError;
+
+typedef void (*AppSyncTupleChangedCallback)(const uint32_t key, const Tuple *new_tuple, const Tuple *old_tuple, void *context);
+typedef void (*AppSyncErrorCallback)(DictionaryResult dict_error, AppMessageResult app_message_error, void *context);
+
+typedef struct AppSync {
+  DictionaryIterator current_iter;
+  union {
+    Dictionary *current;
+    uint8_t *buffer;
+  };
+  uint16_t buffer_size;
+  struct {
+    AppSyncTupleChangedCallback value_changed;
+    AppSyncErrorCallback error;
+    void *context;
+  } callback;
+} AppSync;
+
+void app_sync_init(struct AppSync *s, uint8_t *buffer, const uint16_t buffer_size, const Tuplet *const keys_and_initial_values,
+                   const uint8_t count, AppSyncTupleChangedCallback tuple_changed_callback,
+                   AppSyncErrorCallback error_callback, void *context);
+void app_sync_deinit(struct AppSync *s);
+AppMessageResult app_sync_set(struct AppSync *s, const Tuplet *const keys_and_values_to_update, const uint8_t count);
+const Tuple *app_sync_get(const struct AppSync *s, const uint32_t key);
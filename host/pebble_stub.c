@@ -0,0 +1,1727 @@
+// In-memory implementation of host/pebble.h. Models the parts of the firmware the watchface
+// touches closely enough to count what it costs: app heap, resource loads, dirty marks, timers,
+// animation frames and render passes, all against a virtual clock driven by stub_advance().
+#include <stdarg.h>
+
+#include "pebble_stub.h"
+#include "stub_resources.h"
+
+// the stub's own bookkeeping is not app heap
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#undef time
+
+#define SCREEN_W 144
+#define SCREEN_H 168
+
+StubCounters stub_counters;
+StubHandlerStats stub_handler_stats[STUB_HANDLER_COUNT];
+
+const char *const STUB_HANDLER_NAMES[STUB_HANDLER_COUNT] = {
+  "tick", "battery", "bluetooth", "message", "timer", "animation", "render"
+};
+
+static time_t s_start_time;
+static uint64_t s_now_ms;
+static bool s_dirty;
+static bool s_log_enabled = true;
+static bool s_24h_style;
+
+// ---- handler timing
+
+static uint64_t host_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t handler_begin(void) {
+  return host_ns();
+}
+
+static void handler_end(StubHandler handler, uint64_t started) {
+  uint64_t spent = host_ns() - started;
+  StubHandlerStats *stats = &stub_handler_stats[handler];
+  stats->calls++;
+  stats->total_ns += spent;
+  if (spent > stats->max_ns) stats->max_ns = spent;
+}
+
+// ---- heap
+
+typedef struct {
+  size_t size;
+  uint32_t magic;
+} HeapHeader;
+
+#define HEAP_MAGIC 0x50424c48
+
+void *stub_malloc(size_t size) {
+  HeapHeader *header = malloc(sizeof(HeapHeader) + size);
+  if (header == NULL) return NULL;
+  header->size = size;
+  header->magic = HEAP_MAGIC;
+
+  stub_counters.allocs++;
+  stub_counters.alloc_bytes += size;
+  stub_counters.heap_used += size;
+  if (stub_counters.heap_used > stub_counters.heap_peak) {
+    stub_counters.heap_peak = stub_counters.heap_used;
+  }
+  return header + 1;
+}
+
+void *stub_calloc(size_t count, size_t size) {
+  void *ptr = stub_malloc(count * size);
+  if (ptr) memset(ptr, 0, count * size);
+  return ptr;
+}
+
+void stub_free(void *ptr) {
+  if (ptr == NULL) return;
+  HeapHeader *header = (HeapHeader *) ptr - 1;
+  if (header->magic != HEAP_MAGIC) {
+    fprintf(stderr, "stub: free of a pointer not from the app heap\n");
+    abort();
+  }
+  header->magic = 0;
+  stub_counters.frees++;
+  stub_counters.heap_used -= header->size;
+  free(header);
+}
+
+void *stub_realloc(void *ptr, size_t size) {
+  if (ptr == NULL) return stub_malloc(size);
+  HeapHeader *header = (HeapHeader *) ptr - 1;
+  void *resized = stub_malloc(size);
+  if (resized == NULL) return NULL;
+  memcpy(resized, ptr, header->size < size ? header->size : size);
+  stub_free(ptr);
+  return resized;
+}
+
+size_t heap_bytes_used(void) {
+  return stub_counters.heap_used;
+}
+
+size_t heap_bytes_free(void) {
+  return stub_counters.heap_used < STUB_HEAP_SIZE ? STUB_HEAP_SIZE - stub_counters.heap_used : 0;
+}
+
+// ---- logging
+
+void stub_set_log_enabled(bool enabled) {
+  s_log_enabled = enabled;
+}
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  if (!s_log_enabled) return;
+
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%llu] %s:%d ", (unsigned long long) s_now_ms, src_filename, src_line_number);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+// ---- geometry
+
+bool grect_equal(const GRect *rect_a, const GRect *rect_b) {
+  return memcmp(rect_a, rect_b, sizeof(GRect)) == 0;
+}
+
+bool gpoint_equal(const GPoint *point_a, const GPoint *point_b) {
+  return point_a->x == point_b->x && point_a->y == point_b->y;
+}
+
+static GRect rect_intersect(GRect a, GRect b) {
+  int16_t x0 = a.origin.x > b.origin.x ? a.origin.x : b.origin.x;
+  int16_t y0 = a.origin.y > b.origin.y ? a.origin.y : b.origin.y;
+  int16_t x1 = a.origin.x + a.size.w < b.origin.x + b.size.w ? a.origin.x + a.size.w : b.origin.x + b.size.w;
+  int16_t y1 = a.origin.y + a.size.h < b.origin.y + b.size.h ? a.origin.y + a.size.h : b.origin.y + b.size.h;
+  if (x1 <= x0 || y1 <= y0) return GRectZero;
+  return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+// ---- resources and bitmaps
+
+static const StubResource *find_resource(uint32_t resource_id) {
+  for (size_t i = 0; i < STUB_RESOURCE_COUNT; i++) {
+    if (STUB_RESOURCES[i].id == resource_id) return &STUB_RESOURCES[i];
+  }
+  return NULL;
+}
+
+static uint16_t row_size_bytes(int16_t width) {
+  // 1 bit per pixel, rows padded to 32 bits as on aplite
+  return (uint16_t) (((width + 31) / 32) * 4);
+}
+
+static GBitmap *bitmap_alloc(GSize size) {
+  GBitmap *bitmap = stub_calloc(1, sizeof(GBitmap));
+  bitmap->row_size_bytes = row_size_bytes(size.w);
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->heap_bytes = (size_t) bitmap->row_size_bytes * size.h;
+  bitmap->addr = stub_calloc(1, bitmap->heap_bytes);
+  stub_counters.bitmap_creates++;
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  const StubResource *resource = find_resource(resource_id);
+  if (resource == NULL || resource->kind != STUB_RESOURCE_BITMAP) return NULL;
+
+  stub_counters.resource_loads++;
+  stub_counters.resource_bytes += resource->file_size;
+  GBitmap *bitmap = bitmap_alloc(GSize(resource->width, resource->height));
+  bitmap->resource_id = resource_id;
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_blank(GSize size) {
+  return bitmap_alloc(size);
+}
+
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect) {
+  if (base_bitmap == NULL) return NULL;
+
+  GBitmap *bitmap = stub_calloc(1, sizeof(GBitmap));
+  *bitmap = *base_bitmap;
+  bitmap->parent = (GBitmap *) base_bitmap;
+  bitmap->bounds = rect_intersect(sub_rect, base_bitmap->bounds);
+  bitmap->heap_bytes = 0;
+  stub_counters.bitmap_creates++;
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (bitmap == NULL) return;
+  if (bitmap->parent == NULL) stub_free(bitmap->addr);
+  stub_free(bitmap);
+}
+
+#ifndef PBL_PLATFORM_APLITE
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds) {
+  bitmap->bounds = bounds;
+}
+#endif
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->addr;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->row_size_bytes;
+}
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  return (ResHandle) find_resource(resource_id);
+}
+
+size_t resource_size(ResHandle h) {
+  return h ? ((const StubResource *) h)->file_size : 0;
+}
+
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes) {
+  const StubResource *resource = (const StubResource *) h;
+  if (resource == NULL || start_offset >= resource->file_size) return 0;
+
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", STUB_RESOURCE_ROOT, resource->path);
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return 0;
+  fseek(f, start_offset, SEEK_SET);
+  size_t read = fread(buffer, 1, num_bytes, f);
+  fclose(f);
+
+  stub_counters.resource_loads++;
+  stub_counters.resource_bytes += read;
+  return read;
+}
+
+size_t resource_load(ResHandle h, uint8_t *buffer, size_t max_length) {
+  return resource_load_byte_range(h, 0, buffer, max_length);
+}
+
+struct GFontStub {
+  bool custom;
+  const StubResource *resource;
+};
+
+static struct GFontStub s_system_font = { false, NULL };
+
+GFont fonts_get_system_font(const char *font_key) {
+  return &s_system_font;
+}
+
+GFont fonts_load_custom_font(ResHandle handle) {
+  const StubResource *resource = (const StubResource *) handle;
+  if (resource == NULL) return NULL;
+
+  stub_counters.resource_loads++;
+  stub_counters.resource_bytes += resource->file_size;
+  GFont font = stub_malloc(STUB_FONT_HEAP_BYTES);
+  memset(font, 0, STUB_FONT_HEAP_BYTES);
+  font->custom = true;
+  font->resource = resource;
+  return font;
+}
+
+void fonts_unload_custom_font(GFont font) {
+  if (font && font->custom) stub_free(font);
+}
+
+// ---- graphics
+
+static uint32_t fnv(uint32_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static uint32_t hash_bitmap(uint32_t hash, const GBitmap *bitmap) {
+  uint32_t id = bitmap ? (bitmap->parent ? bitmap->parent->resource_id : bitmap->resource_id) : 0;
+  hash = fnv(hash, &id, sizeof(id));
+  if (bitmap) hash = fnv(hash, &bitmap->bounds, sizeof(bitmap->bounds));
+  return hash;
+}
+
+struct GContext {
+  GPoint offset; // layer origin in screen coordinates
+  GRect clip;
+  GColor stroke;
+  GColor fill;
+  GColor text;
+  GCompOp mode;
+  bool custom;   // handed to an update_proc: its draws go into s_draw_hash
+};
+
+#define FNV_BASIS 2166136261u
+
+// what the update_procs drew in the last render; the built-in layers are hashed from their state
+static uint32_t s_draw_hash = FNV_BASIS;
+
+static void hash_draw(GContext *ctx, const char *op, GRect rect, const void *data, size_t size) {
+  if (!ctx->custom) return;
+  s_draw_hash = fnv(s_draw_hash, op, strlen(op));
+  s_draw_hash = fnv(s_draw_hash, &rect, sizeof(rect));
+  s_draw_hash = fnv(s_draw_hash, &ctx->mode, sizeof(ctx->mode));
+  if (data) s_draw_hash = fnv(s_draw_hash, data, size);
+}
+
+static void count_pixels(GContext *ctx, GRect rect) {
+  rect.origin.x += ctx->offset.x;
+  rect.origin.y += ctx->offset.y;
+  GRect visible = rect_intersect(rect, ctx->clip);
+  stub_counters.pixels_drawn += (uint64_t) visible.size.w * visible.size.h;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) { ctx->stroke = color; }
+void graphics_context_set_fill_color(GContext *ctx, GColor color) { ctx->fill = color; }
+void graphics_context_set_text_color(GContext *ctx, GColor color) { ctx->text = color; }
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) { ctx->mode = mode; }
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, int corner_mask) {
+  hash_draw(ctx, "fill", rect, &ctx->fill, sizeof(ctx->fill));
+  count_pixels(ctx, rect);
+}
+
+void graphics_draw_rect(GContext *ctx, GRect rect) {
+  count_pixels(ctx, GRect(rect.origin.x, rect.origin.y, rect.size.w, 1));
+  count_pixels(ctx, GRect(rect.origin.x, rect.origin.y + rect.size.h - 1, rect.size.w, 1));
+  count_pixels(ctx, GRect(rect.origin.x, rect.origin.y, 1, rect.size.h));
+  count_pixels(ctx, GRect(rect.origin.x + rect.size.w - 1, rect.origin.y, 1, rect.size.h));
+}
+
+void graphics_draw_pixel(GContext *ctx, GPoint point) {
+  count_pixels(ctx, GRect(point.x, point.y, 1, 1));
+}
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  int16_t dx = abs(p1.x - p0.x), dy = abs(p1.y - p0.y);
+  stub_counters.pixels_drawn += (dx > dy ? dx : dy) + 1;
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  if (bitmap == NULL) return;
+  if (ctx->custom) {
+    uint32_t bitmap_hash = hash_bitmap(FNV_BASIS, bitmap);
+    hash_draw(ctx, "bitmap", rect, &bitmap_hash, sizeof(bitmap_hash));
+  }
+  rect.size.w = rect.size.w < bitmap->bounds.size.w ? rect.size.w : bitmap->bounds.size.w;
+  rect.size.h = rect.size.h < bitmap->bounds.size.h ? rect.size.h : bitmap->bounds.size.h;
+  count_pixels(ctx, rect);
+}
+
+GSize graphics_text_layout_get_content_size(const char *text, GFont const font, const GRect box,
+                                            const GTextOverflowMode overflow_mode,
+                                            const GTextAlignment alignment) {
+  // rough metrics: 8 px per character, one 18 px line
+  int16_t width = text ? (int16_t) strlen(text) * 8 : 0;
+  return GSize(width < box.size.w ? width : box.size.w, text && *text ? 18 : 0);
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        void *text_attributes) {
+  if (text == NULL || *text == '\0') return;
+  if (ctx->custom) {
+    hash_draw(ctx, "text", box, text, strlen(text));
+    s_draw_hash = fnv(s_draw_hash, &ctx->text, sizeof(ctx->text));
+    s_draw_hash = fnv(s_draw_hash, &alignment, sizeof(alignment));
+  }
+  GSize size = graphics_text_layout_get_content_size(text, font, box, overflow_mode, alignment);
+  count_pixels(ctx, GRect(box.origin.x, box.origin.y, size.w, size.h));
+}
+
+// ---- layers
+
+typedef enum {
+  LAYER_PLAIN,
+  LAYER_BITMAP,
+  LAYER_TEXT,
+  LAYER_INVERTER,
+} LayerKind;
+
+struct Layer {
+  LayerKind kind;
+  GRect frame;
+  GRect bounds;
+  bool hidden;
+  bool clips;
+  Layer *parent;
+  Layer *first_child;
+  Layer *next_sibling;
+  LayerUpdateProc update_proc;
+  void *data;
+  uint32_t dirty_pass;   // render pass it was last marked dirty for
+};
+
+struct BitmapLayer {
+  Layer layer;
+  const GBitmap *bitmap;
+  GAlign alignment;
+  GColor background;
+  GCompOp mode;
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+  GFont font;
+  GColor text_color;
+  GColor background;
+  GTextAlignment alignment;
+  GTextOverflowMode overflow;
+};
+
+struct InverterLayer {
+  Layer layer;
+};
+
+static void layer_init(Layer *layer, LayerKind kind, GRect frame) {
+  layer->kind = kind;
+  layer->frame = frame;
+  layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+  layer->clips = true;
+}
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = stub_calloc(1, sizeof(Layer));
+  layer_init(layer, LAYER_PLAIN, frame);
+  return layer;
+}
+
+Layer *layer_create_with_data(GRect frame, size_t data_size) {
+  Layer *layer = stub_calloc(1, sizeof(Layer) + data_size);
+  layer_init(layer, LAYER_PLAIN, frame);
+  layer->data = layer + 1;
+  return layer;
+}
+
+void layer_mark_dirty(Layer *layer) {
+  stub_counters.mark_dirty++;
+  s_dirty = true;
+
+  // the pass the mark is for; a layer marked again before it counts once
+  uint32_t pass = stub_counters.redraws + 1;
+  if (layer && layer->dirty_pass != pass) {
+    layer->dirty_pass = pass;
+    stub_counters.dirty_layers++;
+    stub_counters.dirty_pixels += (uint64_t) layer->frame.size.w * layer->frame.size.h;
+  }
+}
+
+void layer_remove_from_parent(Layer *child) {
+  if (child == NULL || child->parent == NULL) return;
+
+  Layer **link = &child->parent->first_child;
+  while (*link && *link != child) link = &(*link)->next_sibling;
+  if (*link) *link = child->next_sibling;
+  layer_mark_dirty(child->parent);
+  child->parent = NULL;
+  child->next_sibling = NULL;
+}
+
+static void layer_deinit(Layer *layer) {
+  layer_remove_from_parent(layer);
+  // children are orphaned, as in the firmware
+  for (Layer *child = layer->first_child; child; ) {
+    Layer *next = child->next_sibling;
+    child->parent = NULL;
+    child->next_sibling = NULL;
+    child = next;
+  }
+}
+
+void layer_destroy(Layer *layer) {
+  if (layer == NULL) return;
+  layer_deinit(layer);
+  stub_free(layer);
+}
+
+void *layer_get_data(const Layer *layer) {
+  return layer->data;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+  if (grect_equal(&frame, &layer->frame)) return;
+  layer->frame = frame;
+  layer->bounds.size = frame.size;
+  stub_counters.frame_sets++;
+  layer_mark_dirty(layer);
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+void layer_set_bounds(Layer *layer, GRect bounds) {
+  if (grect_equal(&bounds, &layer->bounds)) return;
+  layer->bounds = bounds;
+  layer_mark_dirty(layer);
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_remove_from_parent(child);
+  Layer **link = &parent->first_child;
+  while (*link) link = &(*link)->next_sibling;
+  *link = child;
+  child->parent = parent;
+  layer_mark_dirty(child);
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  if (layer->hidden == hidden) return;
+  layer->hidden = hidden;
+  layer_mark_dirty(layer);
+}
+
+bool layer_get_hidden(const Layer *layer) {
+  return layer->hidden;
+}
+
+void layer_set_clips(Layer *layer, bool clips) {
+  layer->clips = clips;
+}
+
+BitmapLayer *bitmap_layer_create(GRect frame) {
+  BitmapLayer *bitmap_layer = stub_calloc(1, sizeof(BitmapLayer));
+  layer_init(&bitmap_layer->layer, LAYER_BITMAP, frame);
+  bitmap_layer->background = GColorClear;
+  bitmap_layer->alignment = GAlignCenter;
+  return bitmap_layer;
+}
+
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer) {
+  if (bitmap_layer == NULL) return;
+  layer_deinit(&bitmap_layer->layer);
+  stub_free(bitmap_layer);
+}
+
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer) {
+  return (Layer *) &bitmap_layer->layer;
+}
+
+const GBitmap *bitmap_layer_get_bitmap(BitmapLayer *bitmap_layer) {
+  return bitmap_layer->bitmap;
+}
+
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap) {
+  bitmap_layer->bitmap = bitmap;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+void bitmap_layer_set_alignment(BitmapLayer *bitmap_layer, GAlign alignment) {
+  bitmap_layer->alignment = alignment;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+void bitmap_layer_set_background_color(BitmapLayer *bitmap_layer, GColor color) {
+  bitmap_layer->background = color;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+void bitmap_layer_set_compositing_mode(BitmapLayer *bitmap_layer, GCompOp mode) {
+  bitmap_layer->mode = mode;
+  layer_mark_dirty(&bitmap_layer->layer);
+}
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = stub_calloc(1, sizeof(TextLayer));
+  layer_init(&text_layer->layer, LAYER_TEXT, frame);
+  text_layer->background = GColorWhite;
+  text_layer->text_color = GColorBlack;
+  text_layer->font = &s_system_font;
+  return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+  if (text_layer == NULL) return;
+  layer_deinit(&text_layer->layer);
+  stub_free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+const char *text_layer_get_text(TextLayer *text_layer) {
+  return text_layer->text;
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+  text_layer->background = color;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+  text_layer->text_color = color;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+  text_layer->alignment = text_alignment;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode) {
+  text_layer->overflow = line_mode;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+InverterLayer *inverter_layer_create(GRect frame) {
+  InverterLayer *inverter_layer = stub_calloc(1, sizeof(InverterLayer));
+  layer_init(&inverter_layer->layer, LAYER_INVERTER, frame);
+  return inverter_layer;
+}
+
+void inverter_layer_destroy(InverterLayer *inverter_layer) {
+  if (inverter_layer == NULL) return;
+  layer_deinit(&inverter_layer->layer);
+  stub_free(inverter_layer);
+}
+
+Layer *inverter_layer_get_layer(InverterLayer *inverter_layer) {
+  return &inverter_layer->layer;
+}
+
+// ---- windows and rendering
+
+struct Window {
+  Layer *root;
+  WindowHandlers handlers;
+  GColor background;
+  bool loaded;
+};
+
+static Window *s_top_window;
+
+Window *window_create(void) {
+  Window *window = stub_calloc(1, sizeof(Window));
+  window->root = layer_create(GRect(0, 0, SCREEN_W, SCREEN_H));
+  window->background = GColorWhite;
+  return window;
+}
+
+void window_destroy(Window *window) {
+  if (window == NULL) return;
+  if (s_top_window == window) window_stack_remove(window, false);
+  layer_destroy(window->root);
+  stub_free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {
+  window->background = background_color;
+  layer_mark_dirty(window->root);
+}
+
+Layer *window_get_root_layer(const Window *window) {
+  return window->root;
+}
+
+void window_stack_push(Window *window, bool animated) {
+  s_top_window = window;
+  if (!window->loaded && window->handlers.load) window->handlers.load(window);
+  window->loaded = true;
+  if (window->handlers.appear) window->handlers.appear(window);
+  layer_mark_dirty(window->root);
+}
+
+Window *window_stack_remove(Window *window, bool animated) {
+  if (s_top_window != window) return NULL;
+  if (window->handlers.disappear) window->handlers.disappear(window);
+  if (window->loaded && window->handlers.unload) window->handlers.unload(window);
+  window->loaded = false;
+  s_top_window = NULL;
+  return window;
+}
+
+Layer *stub_root_layer(void) {
+  return s_top_window ? s_top_window->root : NULL;
+}
+
+static GRect aligned_rect(GRect bounds, GSize size, GAlign alignment) {
+  GRect rect = GRect(bounds.origin.x, bounds.origin.y, size.w, size.h);
+  if (alignment == GAlignCenter || alignment == GAlignTop || alignment == GAlignBottom) {
+    rect.origin.x += (bounds.size.w - size.w) / 2;
+  } else if (alignment == GAlignRight || alignment == GAlignTopRight || alignment == GAlignBottomRight) {
+    rect.origin.x += bounds.size.w - size.w;
+  }
+  if (alignment == GAlignCenter || alignment == GAlignLeft || alignment == GAlignRight) {
+    rect.origin.y += (bounds.size.h - size.h) / 2;
+  } else if (alignment == GAlignBottom || alignment == GAlignBottomLeft || alignment == GAlignBottomRight) {
+    rect.origin.y += bounds.size.h - size.h;
+  }
+  return rect;
+}
+
+static void draw_layer(Layer *layer, GPoint offset, GRect clip) {
+  if (layer->hidden) return;
+
+  GRect frame = layer->frame;
+  frame.origin.x += offset.x;
+  frame.origin.y += offset.y;
+  if (layer->clips) clip = rect_intersect(clip, frame);
+  if (clip.size.w == 0 || clip.size.h == 0) return;
+
+  stub_counters.layer_draws++;
+
+  GContext ctx = {
+    .offset = GPoint(frame.origin.x + layer->bounds.origin.x, frame.origin.y + layer->bounds.origin.y),
+    .clip = clip,
+  };
+  GRect local = GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+
+  switch (layer->kind) {
+    case LAYER_BITMAP: {
+      BitmapLayer *bitmap_layer = (BitmapLayer *) layer;
+      if (bitmap_layer->background != GColorClear) graphics_fill_rect(&ctx, local, 0, GCornerNone);
+      if (bitmap_layer->bitmap) {
+        GRect rect = aligned_rect(local, bitmap_layer->bitmap->bounds.size, bitmap_layer->alignment);
+        graphics_draw_bitmap_in_rect(&ctx, bitmap_layer->bitmap, rect);
+      }
+      break;
+    }
+    case LAYER_TEXT: {
+      TextLayer *text_layer = (TextLayer *) layer;
+      if (text_layer->background != GColorClear) graphics_fill_rect(&ctx, local, 0, GCornerNone);
+      graphics_draw_text(&ctx, text_layer->text, text_layer->font, local, text_layer->overflow,
+                         text_layer->alignment, NULL);
+      break;
+    }
+    case LAYER_INVERTER:
+      graphics_fill_rect(&ctx, local, 0, GCornerNone);
+      break;
+    case LAYER_PLAIN:
+      break;
+  }
+  if (layer->update_proc) {
+    ctx.custom = true;
+    layer->update_proc(layer, &ctx);
+  }
+
+  GPoint child_offset = GPoint(frame.origin.x + layer->bounds.origin.x, frame.origin.y + layer->bounds.origin.y);
+  for (Layer *child = layer->first_child; child; child = child->next_sibling) {
+    draw_layer(child, child_offset, clip);
+  }
+}
+
+// one render pass per event-loop turn that left something dirty
+static void stub_render(void) {
+  if (!s_dirty || s_top_window == NULL) return;
+  s_dirty = false;
+
+  uint64_t started = handler_begin();
+  stub_counters.redraws++;
+  s_draw_hash = FNV_BASIS;
+  GRect screen = GRect(0, 0, SCREEN_W, SCREEN_H);
+  stub_counters.pixels_drawn += SCREEN_W * SCREEN_H; // window background
+  draw_layer(s_top_window->root, GPointZero, screen);
+  handler_end(STUB_HANDLER_RENDER, started);
+}
+
+static uint32_t hash_layer(uint32_t hash, const Layer *layer) {
+  hash = fnv(hash, &layer->kind, sizeof(layer->kind));
+  hash = fnv(hash, &layer->frame, sizeof(layer->frame));
+  hash = fnv(hash, &layer->bounds, sizeof(layer->bounds));
+  hash = fnv(hash, &layer->hidden, sizeof(layer->hidden));
+  if (layer->kind == LAYER_BITMAP) {
+    hash = hash_bitmap(hash, ((const BitmapLayer *) layer)->bitmap);
+  } else if (layer->kind == LAYER_TEXT) {
+    const char *text = ((const TextLayer *) layer)->text;
+    if (text) hash = fnv(hash, text, strlen(text));
+  }
+  for (const Layer *child = layer->first_child; child; child = child->next_sibling) {
+    hash = hash_layer(hash, child);
+  }
+  return hash;
+}
+
+uint32_t stub_state_hash(void) {
+  if (s_top_window == NULL) return 0;
+  return hash_layer(s_draw_hash, s_top_window->root);
+}
+
+// ---- animation
+
+struct Animation {
+  const AnimationImplementation *implementation;
+  AnimationHandlers handlers;
+  void *context;
+  AnimationCurve curve;
+  uint32_t duration;
+  uint32_t delay;
+  bool scheduled;
+  bool started;
+  uint64_t start_ms;
+  uint64_t next_frame_ms;
+  Animation *next;
+  // property animations only
+  Layer *layer;
+  GRect from;
+  GRect to;
+};
+
+struct PropertyAnimation {
+  Animation animation;
+};
+
+static Animation *s_animations;
+
+static Animation *animation_alloc(void) {
+  Animation *animation = stub_calloc(1, sizeof(Animation));
+  animation->duration = 250;
+  animation->curve = AnimationCurveEaseInOut;
+  animation->next = s_animations;
+  s_animations = animation;
+  return animation;
+}
+
+static bool animation_live(Animation *animation) {
+  for (Animation *a = s_animations; a; a = a->next) {
+    if (a == animation) return true;
+  }
+  return false;
+}
+
+Animation *animation_create(void) {
+  return animation_alloc();
+}
+
+bool animation_destroy(Animation *animation) {
+  if (animation == NULL || !animation_live(animation)) return false;
+  animation_unschedule(animation);
+
+  Animation **link = &s_animations;
+  while (*link != animation) link = &(*link)->next;
+  *link = animation->next;
+  stub_free(animation);
+  return true;
+}
+
+bool animation_set_implementation(Animation *animation, const AnimationImplementation *implementation) {
+  if (animation->scheduled) return false;
+  animation->implementation = implementation;
+  return true;
+}
+
+bool animation_set_handlers(Animation *animation, AnimationHandlers callbacks, void *context) {
+  if (animation->scheduled) return false;
+  animation->handlers = callbacks;
+  animation->context = context;
+  return true;
+}
+
+void *animation_get_context(Animation *animation) {
+  return animation->context;
+}
+
+bool animation_set_curve(Animation *animation, AnimationCurve curve) {
+  if (animation->scheduled) return false;
+  animation->curve = curve;
+  return true;
+}
+
+bool animation_set_duration(Animation *animation, uint32_t duration_ms) {
+  if (animation->scheduled) return false;
+  animation->duration = duration_ms;
+  return true;
+}
+
+bool animation_set_delay(Animation *animation, uint32_t delay_ms) {
+  if (animation->scheduled) return false;
+  animation->delay = delay_ms;
+  return true;
+}
+
+bool animation_schedule(Animation *animation) {
+  if (animation->scheduled) animation_unschedule(animation);
+
+  animation->scheduled = true;
+  animation->started = false;
+  animation->start_ms = s_now_ms + animation->delay;
+  animation->next_frame_ms = animation->start_ms;
+  stub_counters.animations_scheduled++;
+  if (animation->implementation && animation->implementation->setup) {
+    animation->implementation->setup(animation);
+  }
+  return true;
+}
+
+static void animation_stop(Animation *animation, bool finished) {
+  animation->scheduled = false;
+  if (animation->implementation && animation->implementation->teardown) {
+    animation->implementation->teardown(animation);
+  }
+  if (animation->handlers.stopped) {
+    animation->handlers.stopped(animation, finished, animation->context);
+  }
+}
+
+bool animation_unschedule(Animation *animation) {
+  if (animation == NULL || !animation->scheduled) return false;
+  animation_stop(animation, false);
+  return true;
+}
+
+bool animation_is_scheduled(Animation *animation) {
+  return animation->scheduled;
+}
+
+static uint32_t apply_curve(AnimationCurve curve, uint32_t t) {
+  uint64_t x = t;
+  switch (curve) {
+    case AnimationCurveEaseIn:
+      return (uint32_t) (x * x / ANIMATION_NORMALIZED_MAX);
+    case AnimationCurveEaseOut:
+      return (uint32_t) (ANIMATION_NORMALIZED_MAX -
+             (ANIMATION_NORMALIZED_MAX - x) * (ANIMATION_NORMALIZED_MAX - x) / ANIMATION_NORMALIZED_MAX);
+    case AnimationCurveEaseInOut:
+      if (x < ANIMATION_NORMALIZED_MAX / 2) return (uint32_t) (2 * x * x / ANIMATION_NORMALIZED_MAX);
+      return (uint32_t) (ANIMATION_NORMALIZED_MAX -
+             2 * (ANIMATION_NORMALIZED_MAX - x) * (ANIMATION_NORMALIZED_MAX - x) / ANIMATION_NORMALIZED_MAX);
+    default:
+      return t;
+  }
+}
+
+static void property_update(Animation *animation, const uint32_t progress) {
+  GRect from = animation->from, to = animation->to, frame;
+  int64_t p = progress;
+  frame.origin.x = from.origin.x + (to.origin.x - from.origin.x) * p / ANIMATION_NORMALIZED_MAX;
+  frame.origin.y = from.origin.y + (to.origin.y - from.origin.y) * p / ANIMATION_NORMALIZED_MAX;
+  frame.size.w = from.size.w + (to.size.w - from.size.w) * p / ANIMATION_NORMALIZED_MAX;
+  frame.size.h = from.size.h + (to.size.h - from.size.h) * p / ANIMATION_NORMALIZED_MAX;
+  layer_set_frame(animation->layer, frame);
+}
+
+static const AnimationImplementation s_property_implementation = {
+  .update = property_update
+};
+
+PropertyAnimation *property_animation_create_layer_frame(Layer *layer, GRect *from_frame, GRect *to_frame) {
+  Animation *animation = animation_alloc();
+  animation->implementation = &s_property_implementation;
+  animation->layer = layer;
+  animation->from = from_frame ? *from_frame : layer->frame;
+  animation->to = to_frame ? *to_frame : layer->frame;
+  return (PropertyAnimation *) animation;
+}
+
+void property_animation_destroy(PropertyAnimation *property_animation) {
+  animation_destroy((Animation *) property_animation);
+}
+
+static void animation_frame(Animation *animation) {
+  if (!animation->started) {
+    animation->started = true;
+    if (animation->handlers.started) animation->handlers.started(animation, animation->context);
+    if (!animation->scheduled) return;
+  }
+
+  uint64_t elapsed = s_now_ms - animation->start_ms;
+  bool done = elapsed >= animation->duration;
+  uint32_t progress = done ? ANIMATION_NORMALIZED_MAX
+                           : (uint32_t) (elapsed * ANIMATION_NORMALIZED_MAX / animation->duration);
+
+  stub_counters.animation_frames++;
+  if (animation->implementation && animation->implementation->update) {
+    uint64_t started = handler_begin();
+    animation->implementation->update(animation, apply_curve(animation->curve, progress));
+    handler_end(STUB_HANDLER_ANIMATION, started);
+  }
+
+  if (!animation_live(animation) || !animation->scheduled) return;
+  if (done) {
+    animation_stop(animation, true);
+  } else {
+    animation->next_frame_ms = s_now_ms + STUB_FRAME_INTERVAL_MS;
+  }
+}
+
+// ---- timers
+
+struct AppTimer {
+  uint64_t fire_ms;
+  AppTimerCallback callback;
+  void *data;
+  bool internal; // stub bookkeeping, not charged to the app
+  AppTimer *next;
+};
+
+static AppTimer *s_timers;
+
+static AppTimer *timer_add(uint32_t timeout_ms, AppTimerCallback callback, void *data, bool internal) {
+  AppTimer *timer = internal ? calloc(1, sizeof(AppTimer)) : stub_calloc(1, sizeof(AppTimer));
+  timer->fire_ms = s_now_ms + timeout_ms;
+  timer->callback = callback;
+  timer->data = data;
+  timer->internal = internal;
+  timer->next = s_timers;
+  s_timers = timer;
+  return timer;
+}
+
+static bool timer_unlink(AppTimer *timer) {
+  for (AppTimer **link = &s_timers; *link; link = &(*link)->next) {
+    if (*link == timer) {
+      *link = timer->next;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void timer_free(AppTimer *timer) {
+  if (timer->internal) {
+    free(timer);
+  } else {
+    stub_free(timer);
+  }
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  stub_counters.timers_registered++;
+  return timer_add(timeout_ms, callback, callback_data, false);
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  for (AppTimer *timer = s_timers; timer; timer = timer->next) {
+    if (timer == timer_handle) {
+      timer->fire_ms = s_now_ms + new_timeout_ms;
+      return true;
+    }
+  }
+  return false;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  if (timer_handle && timer_unlink(timer_handle)) timer_free(timer_handle);
+}
+
+// ---- time and ticks
+
+static TimeUnits s_tick_units;
+static TickHandler s_tick_handler;
+
+time_t stub_time(time_t *tloc) {
+  time_t now = s_start_time + (time_t) (s_now_ms / 1000);
+  if (tloc) *tloc = now;
+  return now;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  uint16_t ms = (uint16_t) (s_now_ms % 1000);
+  stub_time(tloc);
+  if (out_ms) *out_ms = ms;
+  return ms;
+}
+
+uint64_t stub_now_ms(void) {
+  return s_now_ms;
+}
+
+bool clock_is_24h_style(void) {
+  return s_24h_style;
+}
+
+void stub_set_24h_style(bool is_24h) {
+  s_24h_style = is_24h;
+}
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+  s_tick_units = tick_units;
+  s_tick_handler = handler;
+}
+
+void tick_timer_service_unsubscribe(void) {
+  s_tick_units = 0;
+  s_tick_handler = NULL;
+}
+
+static uint64_t next_tick_ms(void) {
+  if (s_tick_handler == NULL) return UINT64_MAX;
+
+  uint64_t period = (s_tick_units & SECOND_UNIT) ? 1000 : 60000;
+  uint64_t wall = (uint64_t) s_start_time * 1000 + s_now_ms;
+  uint64_t next = (wall / period + 1) * period;
+  return next - (uint64_t) s_start_time * 1000;
+}
+
+static void fire_tick(void) {
+  time_t now = stub_time(NULL);
+  struct tm *tick_time = localtime(&now);
+
+  TimeUnits changed = SECOND_UNIT;
+  if (tick_time->tm_sec == 0) {
+    changed |= MINUTE_UNIT;
+    if (tick_time->tm_min == 0) {
+      changed |= HOUR_UNIT;
+      if (tick_time->tm_hour == 0) {
+        changed |= DAY_UNIT;
+        if (tick_time->tm_mday == 1) {
+          changed |= MONTH_UNIT;
+          if (tick_time->tm_mon == 0) changed |= YEAR_UNIT;
+        }
+      }
+    }
+  }
+  if (changed & s_tick_units) {
+    stub_counters.ticks++;
+    uint64_t started = handler_begin();
+    s_tick_handler(tick_time, changed);
+    handler_end(STUB_HANDLER_TICK, started);
+  }
+}
+
+// ---- event loop
+
+void app_event_loop(void) {
+}
+
+void stub_advance(uint32_t ms) {
+  uint64_t target = s_now_ms + ms;
+
+  for (;;) {
+    stub_render();
+
+    uint64_t next = target;
+    for (AppTimer *timer = s_timers; timer; timer = timer->next) {
+      if (timer->fire_ms < next) next = timer->fire_ms;
+    }
+    for (Animation *a = s_animations; a; a = a->next) {
+      if (a->scheduled && a->next_frame_ms < next) next = a->next_frame_ms;
+    }
+    uint64_t tick = next_tick_ms();
+    if (tick < next) next = tick;
+
+    if (next > s_now_ms) s_now_ms = next;
+
+    // timers due now, one at a time since callbacks may add or cancel others
+    for (;;) {
+      AppTimer *due = NULL;
+      for (AppTimer *timer = s_timers; timer; timer = timer->next) {
+        if (timer->fire_ms <= s_now_ms && (due == NULL || timer->fire_ms < due->fire_ms)) due = timer;
+      }
+      if (due == NULL) break;
+      timer_unlink(due);
+      AppTimerCallback callback = due->callback;
+      void *data = due->data;
+      bool internal = due->internal;
+      timer_free(due);
+      if (internal) {
+        callback(data);
+      } else {
+        stub_counters.timers_fired++;
+        uint64_t started = handler_begin();
+        callback(data);
+        handler_end(STUB_HANDLER_TIMER, started);
+      }
+    }
+
+    // one frame for every animation due now; the list can change under the callbacks
+    Animation *due[32];
+    int due_count = 0;
+    for (Animation *a = s_animations; a && due_count < 32; a = a->next) {
+      if (a->scheduled && a->next_frame_ms <= s_now_ms) due[due_count++] = a;
+    }
+    for (int i = 0; i < due_count; i++) {
+      if (animation_live(due[i]) && due[i]->scheduled) animation_frame(due[i]);
+    }
+
+    if (tick == s_now_ms) fire_tick();
+
+    // a timer the tick registered for now, such as a 0 ms one, runs before the turn ends
+    bool timer_due = false;
+    for (AppTimer *timer = s_timers; timer; timer = timer->next) {
+      if (timer->fire_ms <= s_now_ms) timer_due = true;
+    }
+    if (s_now_ms >= target && !timer_due) {
+      stub_render();
+      return;
+    }
+  }
+}
+
+// ---- system services
+
+static BatteryStateHandler s_battery_handler;
+static BatteryChargeState s_battery = { 100, false, false };
+static BluetoothConnectionHandler s_bluetooth_handler;
+static bool s_bluetooth = true;
+
+void battery_state_service_subscribe(BatteryStateHandler handler) { s_battery_handler = handler; }
+void battery_state_service_unsubscribe(void) { s_battery_handler = NULL; }
+BatteryChargeState battery_state_service_peek(void) { return s_battery; }
+
+void stub_set_battery(BatteryChargeState state) {
+  s_battery = state;
+  if (s_battery_handler) {
+    uint64_t started = handler_begin();
+    s_battery_handler(state);
+    handler_end(STUB_HANDLER_BATTERY, started);
+  }
+  stub_render();
+}
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler) { s_bluetooth_handler = handler; }
+void bluetooth_connection_service_unsubscribe(void) { s_bluetooth_handler = NULL; }
+bool bluetooth_connection_service_peek(void) { return s_bluetooth; }
+
+void stub_set_bluetooth(bool connected) {
+  s_bluetooth = connected;
+  if (s_bluetooth_handler) {
+    uint64_t started = handler_begin();
+    s_bluetooth_handler(connected);
+    handler_end(STUB_HANDLER_BLUETOOTH, started);
+  }
+  stub_render();
+}
+
+void vibes_short_pulse(void) { stub_counters.vibes++; }
+void vibes_long_pulse(void) { stub_counters.vibes++; }
+void vibes_double_pulse(void) { stub_counters.vibes++; }
+
+// ---- persistent storage
+
+#define PERSIST_SLOTS 64
+
+typedef struct {
+  bool used;
+  uint32_t key;
+  uint16_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistSlot;
+
+static PersistSlot s_persist[PERSIST_SLOTS];
+
+static PersistSlot *persist_find(uint32_t key) {
+  for (int i = 0; i < PERSIST_SLOTS; i++) {
+    if (s_persist[i].used && s_persist[i].key == key) return &s_persist[i];
+  }
+  return NULL;
+}
+
+static int persist_store(uint32_t key, const void *data, size_t size) {
+  if (size > PERSIST_DATA_MAX_LENGTH) size = PERSIST_DATA_MAX_LENGTH;
+  PersistSlot *slot = persist_find(key);
+  for (int i = 0; slot == NULL && i < PERSIST_SLOTS; i++) {
+    if (!s_persist[i].used) slot = &s_persist[i];
+  }
+  if (slot == NULL) return E_OUT_OF_STORAGE;
+
+  slot->used = true;
+  slot->key = key;
+  slot->size = (uint16_t) size;
+  memcpy(slot->data, data, size);
+  stub_counters.persist_writes++;
+  return (int) size;
+}
+
+static int persist_load(uint32_t key, void *buffer, size_t buffer_size) {
+  stub_counters.persist_reads++;
+  PersistSlot *slot = persist_find(key);
+  if (slot == NULL) return E_DOES_NOT_EXIST;
+  size_t size = slot->size < buffer_size ? slot->size : buffer_size;
+  memcpy(buffer, slot->data, size);
+  return (int) size;
+}
+
+bool persist_exists(const uint32_t key) { return persist_find(key) != NULL; }
+
+int persist_get_size(const uint32_t key) {
+  PersistSlot *slot = persist_find(key);
+  return slot ? slot->size : E_DOES_NOT_EXIST;
+}
+
+bool persist_read_bool(const uint32_t key) {
+  bool value = false;
+  persist_load(key, &value, sizeof(value));
+  return value;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+  int32_t value = 0;
+  persist_load(key, &value, sizeof(value));
+  return value;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  return persist_load(key, buffer, buffer_size);
+}
+
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size) {
+  int read = persist_load(key, buffer, buffer_size);
+  if (read > 0 && buffer_size > 0) buffer[buffer_size - 1] = '\0';
+  return read;
+}
+
+status_t persist_write_bool(const uint32_t key, const bool value) {
+  return persist_store(key, &value, sizeof(value));
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+  return persist_store(key, &value, sizeof(value));
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  return persist_store(key, data, size);
+}
+
+int persist_write_string(const uint32_t key, const char *cstring) {
+  return persist_store(key, cstring, strlen(cstring) + 1);
+}
+
+status_t persist_delete(const uint32_t key) {
+  PersistSlot *slot = persist_find(key);
+  if (slot == NULL) return E_DOES_NOT_EXIST;
+  slot->used = false;
+  return S_SUCCESS;
+}
+
+// ---- dictionaries
+
+#define TUPLE_HEADER_SIZE (sizeof(Tuple))
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+  uint32_t size = sizeof(Dictionary) + tuple_count * TUPLE_HEADER_SIZE;
+  va_list args;
+  va_start(args, tuple_count);
+  for (int i = 0; i < tuple_count; i++) size += va_arg(args, uint32_t);
+  va_end(args);
+  return size;
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *const buffer, const uint16_t size) {
+  if (iter == NULL || buffer == NULL || size < sizeof(Dictionary)) return DICT_INVALID_ARGS;
+  iter->dictionary = (Dictionary *) buffer;
+  iter->dictionary->count = 0;
+  iter->cursor = iter->dictionary->head;
+  iter->end = buffer + size;
+  return DICT_OK;
+}
+
+static DictionaryResult dict_write_raw(DictionaryIterator *iter, uint32_t key, TupleType type,
+                                       const void *data, uint16_t length) {
+  uint8_t *at = (uint8_t *) iter->cursor;
+  if (at + TUPLE_HEADER_SIZE + length > iter->end) return DICT_NOT_ENOUGH_STORAGE;
+
+  Tuple *tuple = iter->cursor;
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  if (length) memcpy(tuple->value, data, length);
+  iter->cursor = (Tuple *) (at + TUPLE_HEADER_SIZE + length);
+  iter->dictionary->count++;
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet *const tuplet) {
+  switch (tuplet->type) {
+    case TUPLE_BYTE_ARRAY:
+      return dict_write_raw(iter, tuplet->key, TUPLE_BYTE_ARRAY, tuplet->bytes.data, tuplet->bytes.length);
+    case TUPLE_CSTRING:
+      return dict_write_raw(iter, tuplet->key, TUPLE_CSTRING, tuplet->cstring.data, tuplet->cstring.length);
+    default:
+      return dict_write_raw(iter, tuplet->key, tuplet->type, &tuplet->integer.storage, tuplet->integer.width);
+  }
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *const data, const uint16_t size) {
+  return dict_write_raw(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *const cstring) {
+  return dict_write_raw(iter, key, TUPLE_CSTRING, cstring, cstring ? (uint16_t) (strlen(cstring) + 1) : 0);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer,
+                                const uint8_t width_bytes, const bool is_signed) {
+  return dict_write_raw(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write_raw(iter, key, TUPLE_UINT, &value, 1);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+  return dict_write_raw(iter, key, TUPLE_INT, &value, 4);
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  uint32_t size = (uint32_t) ((uint8_t *) iter->cursor - (uint8_t *) iter->dictionary);
+  iter->end = (uint8_t *) iter->cursor;
+  iter->cursor = iter->dictionary->head;
+  return size;
+}
+
+static Tuple *tuple_next(const Tuple *tuple) {
+  return (Tuple *) ((uint8_t *) tuple + TUPLE_HEADER_SIZE + tuple->length);
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *const buffer, const uint16_t size) {
+  iter->dictionary = (Dictionary *) buffer;
+  iter->end = buffer + size;
+  return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+  iter->cursor = iter->dictionary->head;
+  if (iter->dictionary->count == 0) return NULL;
+  return iter->cursor;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+  Tuple *next = tuple_next(iter->cursor);
+  if ((uint8_t *) next + TUPLE_HEADER_SIZE > iter->end) return NULL;
+  iter->cursor = next;
+  return next;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  Tuple *tuple = iter->dictionary->head;
+  for (int i = 0; i < iter->dictionary->count; i++) {
+    if (tuple->key == key) return tuple;
+    tuple = tuple_next(tuple);
+  }
+  return NULL;
+}
+
+// ---- AppMessage
+
+static uint32_t s_inbox_size;
+static uint32_t s_outbox_size;
+static uint8_t *s_outbox;
+static DictionaryIterator s_outbox_iter;
+static bool s_outbox_busy;
+static bool s_outbox_sent;
+static void *s_message_context;
+static AppMessageInboxReceived s_inbox_received;
+static AppMessageInboxDropped s_inbox_dropped;
+static AppMessageOutboxSent s_outbox_sent_cb;
+static AppMessageOutboxFailed s_outbox_failed_cb;
+static AppSync *s_sync;
+static StubPhoneHandler s_phone;
+
+#define STUB_MESSAGE_MAX 8200
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  if (s_outbox) return APP_MSG_INVALID_ARGS;
+  s_inbox_size = size_inbound;
+  s_outbox_size = size_outbound;
+  // the firmware carves both buffers out of the app heap
+  s_outbox = stub_malloc(size_outbound);
+  stub_counters.heap_used += size_inbound;
+  stub_counters.message_buffers = size_inbound + size_outbound;
+  if (stub_counters.heap_used > stub_counters.heap_peak) stub_counters.heap_peak = stub_counters.heap_used;
+  return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) { return STUB_MESSAGE_MAX; }
+uint32_t app_message_outbox_size_maximum(void) { return 656; }
+void *app_message_get_context(void) { return s_message_context; }
+
+void *app_message_set_context(void *context) {
+  void *previous = s_message_context;
+  s_message_context = context;
+  return previous;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived previous = s_inbox_received;
+  s_inbox_received = received_callback;
+  return previous;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+  AppMessageInboxDropped previous = s_inbox_dropped;
+  s_inbox_dropped = dropped_callback;
+  return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+  AppMessageOutboxSent previous = s_outbox_sent_cb;
+  s_outbox_sent_cb = sent_callback;
+  return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  AppMessageOutboxFailed previous = s_outbox_failed_cb;
+  s_outbox_failed_cb = failed_callback;
+  return previous;
+}
+
+void app_message_deregister_callbacks(void) {
+  s_inbox_received = NULL;
+  s_inbox_dropped = NULL;
+  s_outbox_sent_cb = NULL;
+  s_outbox_failed_cb = NULL;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  if (s_outbox == NULL) return APP_MSG_INVALID_ARGS;
+  if (s_outbox_busy) return APP_MSG_BUSY;
+  dict_write_begin(&s_outbox_iter, s_outbox, (uint16_t) s_outbox_size);
+  s_outbox_busy = true;
+  *iterator = &s_outbox_iter;
+  return APP_MSG_OK;
+}
+
+static void outbox_complete(void *data) {
+  bool delivered = data != NULL;
+  s_outbox_busy = false;
+  if (delivered) {
+    if (s_outbox_sent_cb) s_outbox_sent_cb(&s_outbox_iter, s_message_context);
+    if (s_phone) s_phone(&s_outbox_iter);
+  } else if (s_sync) {
+    // AppSync owns the AppMessage callbacks and reports failed sends through its error callback
+    if (s_sync->callback.error) s_sync->callback.error(DICT_OK, APP_MSG_NOT_CONNECTED, s_sync->callback.context);
+  } else if (s_outbox_failed_cb) {
+    s_outbox_failed_cb(&s_outbox_iter, APP_MSG_NOT_CONNECTED, s_message_context);
+  }
+}
+
+AppMessageResult app_message_outbox_send(void) {
+  if (!s_outbox_busy) return APP_MSG_INVALID_ARGS;
+
+  uint32_t size = dict_write_end(&s_outbox_iter);
+  stub_counters.outbox_messages++;
+  stub_counters.outbox_bytes += size;
+  s_outbox_sent = true;
+  timer_add(0, outbox_complete, s_bluetooth ? (void *) 1 : NULL, true);
+  return APP_MSG_OK;
+}
+
+const DictionaryIterator *stub_last_outbox(void) {
+  return s_outbox_sent ? &s_outbox_iter : NULL;
+}
+
+// ---- AppSync
+
+static void sync_rebuild(AppSync *s, DictionaryIterator *update) {
+  uint8_t old[STUB_MESSAGE_MAX];
+  uint16_t old_size = (uint16_t) (s->current_iter.end - s->buffer);
+  memcpy(old, s->buffer, old_size);
+  DictionaryIterator old_iter;
+  dict_read_begin_from_buffer(&old_iter, old, old_size);
+
+  uint8_t merged[STUB_MESSAGE_MAX];
+  DictionaryIterator merged_iter = { 0 };
+  dict_write_begin(&merged_iter, merged, s->buffer_size);
+  DictionaryResult result = DICT_OK;
+  for (Tuple *t = dict_read_first(&old_iter); t && result == DICT_OK; t = dict_read_next(&old_iter)) {
+    Tuple *fresh = dict_find(update, t->key);
+    Tuple *source = fresh ? fresh : t;
+    result = dict_write_raw(&merged_iter, source->key, source->type, source->value, source->length);
+  }
+  if (result != DICT_OK) {
+    if (s->callback.error) s->callback.error(result, APP_MSG_OK, s->callback.context);
+    return;
+  }
+
+  uint32_t size = dict_write_end(&merged_iter);
+  memcpy(s->buffer, merged, size);
+  dict_read_begin_from_buffer(&s->current_iter, s->buffer, (uint16_t) size);
+
+  for (Tuple *t = dict_read_first(update); t; t = dict_read_next(update)) {
+    Tuple *now = dict_find(&s->current_iter, t->key);
+    if (now && s->callback.value_changed) {
+      s->callback.value_changed(t->key, now, dict_find(&old_iter, t->key), s->callback.context);
+    }
+  }
+}
+
+void app_sync_init(struct AppSync *s, uint8_t *buffer, const uint16_t buffer_size, const Tuplet *const keys_and_initial_values,
+                   const uint8_t count, AppSyncTupleChangedCallback tuple_changed_callback,
+                   AppSyncErrorCallback error_callback, void *context) {
+  s->buffer = buffer;
+  s->buffer_size = buffer_size;
+  s->callback.value_changed = tuple_changed_callback;
+  s->callback.error = error_callback;
+  s->callback.context = context;
+
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, buffer_size);
+  for (int i = 0; i < count; i++) {
+    DictionaryResult result = dict_write_tuplet(&iter, &keys_and_initial_values[i]);
+    if (result != DICT_OK) {
+      if (error_callback) error_callback(result, APP_MSG_OK, context);
+      break;
+    }
+  }
+  uint32_t size = dict_write_end(&iter);
+  dict_read_begin_from_buffer(&s->current_iter, buffer, (uint16_t) size);
+  s_sync = s;
+
+  for (Tuple *t = dict_read_first(&s->current_iter); t; t = dict_read_next(&s->current_iter)) {
+    if (tuple_changed_callback) tuple_changed_callback(t->key, t, NULL, context);
+  }
+}
+
+void app_sync_deinit(struct AppSync *s) {
+  if (s_sync == s) s_sync = NULL;
+}
+
+AppMessageResult app_sync_set(struct AppSync *s, const Tuplet *const keys_and_values_to_update, const uint8_t count) {
+  DictionaryIterator *out;
+  AppMessageResult result = app_message_outbox_begin(&out);
+  if (result != APP_MSG_OK) return result;
+  for (int i = 0; i < count; i++) dict_write_tuplet(out, &keys_and_values_to_update[i]);
+  return app_message_outbox_send();
+}
+
+const Tuple *app_sync_get(const struct AppSync *s, const uint32_t key) {
+  return dict_find(&s->current_iter, key);
+}
+
+void stub_drop_message(void) {
+  stub_counters.inbox_dropped++;
+  uint64_t started = handler_begin();
+  if (s_sync) {
+    if (s_sync->callback.error) s_sync->callback.error(DICT_OK, APP_MSG_BUFFER_OVERFLOW, s_sync->callback.context);
+  } else if (s_inbox_dropped) {
+    s_inbox_dropped(APP_MSG_BUFFER_OVERFLOW, s_message_context);
+  }
+  handler_end(STUB_HANDLER_MESSAGE, started);
+  stub_render();
+}
+
+void stub_set_phone(StubPhoneHandler handler) {
+  s_phone = handler;
+}
+
+bool stub_deliver_message(const Tuplet *tuplets, uint8_t count) {
+  uint8_t buffer[STUB_MESSAGE_MAX];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  for (int i = 0; i < count; i++) dict_write_tuplet(&iter, &tuplets[i]);
+  uint32_t size = dict_write_end(&iter);
+
+  if (size > s_inbox_size) {
+    stub_drop_message();
+    return false;
+  }
+
+  stub_counters.inbox_messages++;
+  stub_counters.inbox_bytes += size;
+  uint64_t started = handler_begin();
+  if (s_sync) {
+    sync_rebuild(s_sync, &iter);
+  } else if (s_inbox_received) {
+    s_inbox_received(&iter, s_message_context);
+  }
+  handler_end(STUB_HANDLER_MESSAGE, started);
+  stub_render();
+  return true;
+}
+
+// ---- reset
+
+void stub_relaunch(void) {
+  while (s_animations) animation_destroy(s_animations);
+  while (s_timers) {
+    AppTimer *timer = s_timers;
+    s_timers = timer->next;
+    timer_free(timer);
+  }
+  if (s_outbox) stub_free(s_outbox);
+  s_outbox = NULL;
+
+  memset(&stub_counters, 0, sizeof(stub_counters));
+  memset(stub_handler_stats, 0, sizeof(stub_handler_stats));
+  s_dirty = false;
+  s_draw_hash = FNV_BASIS;
+  s_top_window = NULL;
+  s_tick_units = 0;
+  s_tick_handler = NULL;
+  s_battery_handler = NULL;
+  s_bluetooth_handler = NULL;
+  s_inbox_size = s_outbox_size = 0;
+  s_outbox_busy = s_outbox_sent = false;
+  s_message_context = NULL;
+  app_message_deregister_callbacks();
+  s_sync = NULL;
+}
+
+void stub_reset(time_t start_time) {
+  stub_relaunch();
+  memset(s_persist, 0, sizeof(s_persist));
+  s_start_time = start_time;
+  s_now_ms = 0;
+  s_battery = (BatteryChargeState) { 100, false, false };
+  s_bluetooth = true;
+  s_phone = NULL;
+}
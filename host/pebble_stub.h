@@ -0,0 +1,108 @@
+// Control side of the host Pebble stand-in: counters, virtual time and event injection for the
+// drivers in host/. The watchface itself only sees pebble.h.
+#pragma once
+
+#include "pebble.h"
+
+#define STUB_HEAP_SIZE 24576          // aplite app heap
+#define STUB_FRAME_INTERVAL_MS 33     // animation frame period
+#define STUB_FONT_HEAP_BYTES 1024     // estimate for a loaded custom font's app-heap footprint
+
+typedef struct {
+  uint32_t allocs;
+  uint32_t frees;
+  uint64_t alloc_bytes;
+  size_t   heap_used;
+  size_t   heap_peak;
+  size_t   message_buffers;      // AppMessage inbox + outbox, held until the app exits
+
+  uint32_t resource_loads;       // bitmap and font resources pulled from flash
+  uint32_t resource_bytes;       // raw resource bytes read for them
+  uint32_t bitmap_creates;       // every gbitmap_create_*, sub-bitmaps included
+
+  uint32_t mark_dirty;           // explicit and implicit layer_mark_dirty calls
+  uint32_t dirty_layers;         // distinct layers marked dirty, per render pass
+  uint64_t dirty_pixels;         // their frame area: what a redraw of just the dirty rects would cover
+  uint32_t frame_sets;           // layer_set_frame calls that moved a layer
+  uint32_t animations_scheduled;
+  uint32_t animation_frames;     // AnimationImplementation.update calls
+  uint32_t redraws;              // render passes over the window
+  uint32_t layer_draws;          // layers drawn across all passes
+  uint64_t pixels_drawn;         // clipped bitmap, fill and text area drawn
+
+  uint32_t timers_registered;
+  uint32_t timers_fired;
+  uint32_t ticks;
+  uint32_t vibes;
+
+  uint32_t inbox_messages;
+  uint32_t inbox_bytes;
+  uint32_t inbox_dropped;
+  uint32_t outbox_messages;
+  uint32_t outbox_bytes;
+
+  uint32_t persist_reads;
+  uint32_t persist_writes;
+} StubCounters;
+
+extern StubCounters stub_counters;
+
+// host time spent in the app's callbacks, by what invoked them
+typedef enum {
+  STUB_HANDLER_TICK,
+  STUB_HANDLER_BATTERY,
+  STUB_HANDLER_BLUETOOTH,
+  STUB_HANDLER_MESSAGE,
+  STUB_HANDLER_TIMER,
+  STUB_HANDLER_ANIMATION,
+  STUB_HANDLER_RENDER,
+  STUB_HANDLER_COUNT
+} StubHandler;
+
+typedef struct {
+  uint32_t calls;
+  uint64_t total_ns;
+  uint64_t max_ns;
+} StubHandlerStats;
+
+extern StubHandlerStats stub_handler_stats[STUB_HANDLER_COUNT];
+extern const char *const STUB_HANDLER_NAMES[STUB_HANDLER_COUNT];
+
+// clears every piece of stub state; start_time is the wall clock at virtual t = 0
+void stub_reset(time_t start_time);
+
+// ends the app the way the firmware does between launches: persist storage, the clock, battery
+// and Bluetooth carry over, everything the app registered or allocated does not
+void stub_relaunch(void);
+
+// runs timers, animation frames, tick events and redraws up to now + ms
+void stub_advance(uint32_t ms);
+uint64_t stub_now_ms(void);
+
+void stub_set_24h_style(bool is_24h);
+void stub_set_battery(BatteryChargeState state);
+void stub_set_bluetooth(bool connected);
+
+// inbound AppMessage as the phone would send it; false if it was dropped
+bool stub_deliver_message(const Tuplet *tuplets, uint8_t count);
+
+// a message that reached the watch but could not be taken in, as the app sees a dropped inbox
+void stub_drop_message(void);
+
+// the phone's end of the link: sees every message the app sends while connected and may
+// answer with stub_deliver_message
+typedef void (*StubPhoneHandler)(const DictionaryIterator *sent);
+void stub_set_phone(StubPhoneHandler handler);
+
+// the last dictionary the app sent, NULL if none
+const DictionaryIterator *stub_last_outbox(void);
+
+// root layer of the topmost window, NULL when no window is pushed
+Layer *stub_root_layer(void);
+
+void stub_set_log_enabled(bool enabled);
+
+// FNV-1a over the window's layer tree: kinds, frames, hidden flags, bitmaps and text, and over
+// what the update_procs drew in the last render
+uint32_t stub_state_hash(void);
+
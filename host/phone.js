@@ -0,0 +1,256 @@
+// Runs the phone half of the face, src/js/pebble-js-app.js, under node against a mock YQL server
+// on localhost and checks what each kind of refresh costs in HTTP requests.
+//
+// The app runs in a vm context with stand-ins for what PebbleKit JS provides: Pebble,
+// localStorage, XMLHttpRequest (every URL is redirected to the mock server) and geolocation.
+//
+// Usage: node phone.js
+
+'use strict';
+
+var fs = require('fs');
+var http = require('http');
+var path = require('path');
+var vm = require('vm');
+var url = require('url');
+
+var APP = path.join(__dirname, '..', 'src', 'js', 'pebble-js-app.js');
+
+// a timezone half an hour off UTC, so the forecast's local hours are not UTC hours
+process.env.TZ = 'Asia/Kolkata';
+
+// ---- mock YQL
+
+var server = {
+  requests: [],    // one entry per request: 'placefinder', 'places' or 'forecast'
+  stall: false,    // leave requests unanswered
+  port: 0
+};
+
+function yqlResult(query) {
+  if (query.indexOf('geo.placefinder') >= 0) return ['placefinder', { Result: { woeid: '2487956' } }];
+  if (query.indexOf('geo.places') >= 0) return ['places', { place: { woeid: '44418' } }];
+  // one channel per forecast day, as YQL answers a select of item.forecast
+  var condition = { code: '32', temp: '71', text: 'Sunny' };
+  var days = [{ code: '32', high: '75', low: '55' }, { code: '11', high: '60', low: '50' }];
+  return ['forecast', { channel: days.map(function(day) { return { item: { condition: condition, forecast: day } }; }) }];
+}
+
+var httpServer = http.createServer(function(req, res) {
+  var query = url.parse(req.url, true).query.q || '';
+  var result = yqlResult(query);
+  server.requests.push(result[0]);
+  if (server.stall) return; // the client's timeout has to deal with it
+  res.writeHead(200, { 'Content-Type': 'application/json' });
+  res.end(JSON.stringify({ query: { results: result[1] } }));
+});
+
+// ---- PebbleKit JS stand-ins
+
+function makeContext(storage) {
+  var listeners = {};
+  var sent = [];
+
+  function XMLHttpRequest() {
+    this.readyState = 0;
+    this.status = 0;
+    this.responseText = '';
+  }
+  XMLHttpRequest.prototype.open = function(method, target) {
+    var parsed = url.parse(target);
+    this.path = parsed.path;
+  };
+  XMLHttpRequest.prototype.send = function() {
+    var xhr = this;
+    xhr.request = http.get({ host: '127.0.0.1', port: server.port, path: xhr.path }, function(res) {
+      var body = '';
+      res.on('data', function(chunk) { body += chunk; });
+      res.on('end', function() {
+        xhr.readyState = 4;
+        xhr.status = res.statusCode;
+        xhr.responseText = body;
+        if (xhr.onload) xhr.onload({});
+      });
+    });
+    xhr.request.on('error', function() {
+      if (!xhr.aborted && xhr.onerror) xhr.onerror({});
+    });
+  };
+  XMLHttpRequest.prototype.abort = function() {
+    this.aborted = true;
+    if (this.request) this.request.destroy();
+  };
+
+  var context = {
+    console: { log: function() {}, warn: function() {} },
+    setTimeout: setTimeout,
+    clearTimeout: clearTimeout,
+    XMLHttpRequest: XMLHttpRequest,
+    localStorage: {
+      getItem: function(key) { return storage.hasOwnProperty(key) ? storage[key] : null; },
+      setItem: function(key, value) { storage[key] = String(value); }
+    },
+    window: {
+      navigator: {
+        geolocation: {
+          getCurrentPosition: function(success, error, options) {
+            setImmediate(function() { success({ coords: { latitude: 51.5074, longitude: -0.1278 } }); });
+          }
+        }
+      }
+    },
+    Pebble: {
+      addEventListener: function(type, callback) { listeners[type] = callback; },
+      sendAppMessage: function(message, success, failure) {
+        sent.push(message);
+        if (success) setImmediate(function() { success({}); });
+      },
+      openURL: function() {}
+    }
+  };
+  vm.createContext(context);
+  vm.runInContext(fs.readFileSync(APP, 'utf8'), context, { filename: APP });
+
+  return {
+    context: context,
+    sent: sent,
+    emit: function(type, e) { listeners[type](e || {}); }
+  };
+}
+
+// ---- scenarios
+
+// a watch request, resolved once the refresh has settled
+function refresh(phone) {
+  phone.emit('appmessage', { payload: { request: 1 } });
+  return waitIdle(phone);
+}
+
+function waitIdle(phone) {
+  return new Promise(function(resolve) {
+    (function poll() {
+      if (!phone.context.refreshing) resolve();
+      else setTimeout(poll, 5);
+    })();
+  });
+}
+
+var failures = 0;
+
+function check(name, actual, expected) {
+  var ok = JSON.stringify(actual) === JSON.stringify(expected);
+  if (!ok) failures++;
+  console.log((ok ? 'ok   ' : 'FAIL ') + name + ': ' + JSON.stringify(actual) +
+              (ok ? '' : ' (expected ' + JSON.stringify(expected) + ')'));
+}
+
+function counted(action) {
+  var before = server.requests.length;
+  return action().then(function() { return server.requests.slice(before); });
+}
+
+function run() {
+  var storage = {};
+  var phone = makeContext(storage);
+
+  return counted(function() { return refresh(phone); }).then(function(requests) {
+    check('first refresh looks the place up', requests, ['placefinder', 'forecast']);
+    check('watch gets packed weather', phone.sent[0].weather, [1, 71, 0, 0, 0, 32]);
+    check('settings go with the first update',
+          [phone.sent[0].invert_color, phone.sent[0].bluetoothvibe, phone.sent[0].blink, phone.sent[0].animation],
+          [0, 0, 0, 0]);
+    var forecast = phone.sent[0].forecast;
+    var start = forecast[1] + forecast[2] * 256 + forecast[3] * 65536 + forecast[4] * 16777216;
+    check('forecast covers the next 24 local hours from this one',
+          [forecast[0], forecast[6], forecast.length, start % 3600, start <= Date.now() / 1000,
+           Date.now() / 1000 - start < 3600],
+          [1, 24, 7 + 24 * 3, 1800, true, true]);
+    var hour = new Date(start * 1000).getHours();
+    check('forecast starts with the current condition', forecast.slice(7, 10),
+          [71, hour < 6 || hour >= 20 ? 1 : 0, 32]); // clear, at night the night icon
+    var temps = [];
+    for (var i = 7; i < forecast.length; i += 3) temps.push(forecast[i]);
+    check('forecast stays within the days\' lows and highs',
+          [Math.min.apply(null, temps.slice(1)) >= 50, Math.max.apply(null, temps.slice(1)) <= 75], [true, true]);
+
+    return counted(function() { return refresh(phone); });
+  }).then(function(requests) {
+    check('next refresh is one request', requests, ['forecast']);
+    check('settings are not resent', Object.keys(phone.sent[1]), ['weather', 'forecast']);
+
+    // a relaunched JS app starts from localStorage
+    phone = makeContext(storage);
+    return counted(function() { return refresh(phone); });
+  }).then(function(requests) {
+    check('cache survives a relaunch', requests, ['forecast']);
+
+    return counted(function() {
+      phone.emit('appmessage', { payload: { request: 1 } });
+      phone.emit('appmessage', { payload: { request: 1 } });
+      phone.emit('appmessage', { payload: { request: 1 } });
+      return waitIdle(phone).then(function() { return waitIdle(phone); });
+    });
+  }).then(function(requests) {
+    check('overlapping requests run one at a time, once more after', requests, ['forecast', 'forecast']);
+
+    server.stall = true;
+    phone.context.REQUEST_TIMEOUT = 100;
+    var sentBefore = phone.sent.length;
+    return counted(function() { return refresh(phone); }).then(function(requests) {
+      check('stalled request times out without a message', [requests, phone.sent.length - sentBefore], [['forecast'], 0]);
+      server.stall = false;
+      return counted(function() { return refresh(phone); });
+    });
+  }).then(function(requests) {
+    check('refresh after a timeout works', requests, ['forecast']);
+
+    phone.context.options.use_gps = 'false';
+    phone.context.options.location = 'London';
+    return counted(function() { return refresh(phone); });
+  }).then(function(requests) {
+    check('new location name is looked up', requests, ['places', 'forecast']);
+    return counted(function() { return refresh(phone); });
+  }).then(function(requests) {
+    check('known location name is one request', requests, ['forecast']);
+
+    phone.context.options.animation = 'off';
+    return refresh(phone);
+  }).then(function() {
+    var last = phone.sent[phone.sent.length - 1];
+    check('only the changed animation setting is resent', [Object.keys(last), last.animation],
+          [['animation', 'weather', 'forecast'], 3]);
+
+    phone.emit('ready', { type: 'ready' });
+    var sent = phone.sent.length;
+    phone.emit('ready', { type: 'ready' });
+    check('the energy ledger is asked for again until one arrives',
+          [Object.keys(phone.sent[sent - 1]), phone.sent.length], [['ledger_request'], sent + 1]);
+
+    // 01:00 at 100% with some activity and 02:00 with no battery reading, then a later copy of 02:00
+    phone.emit('appmessage', { payload: { ledger: [1, 0x10, 0x0e, 0, 0, 2,
+                                                   100, 0x2c, 0x01, 3, 0x2c, 0x01, 1, 0,
+                                                   0xFF, 0, 0, 0, 0, 0, 0, 1] } });
+    phone.emit('appmessage', { payload: { ledger: [1, 0x20, 0x1c, 0, 0, 1, 0xA8, 5, 0, 1, 9, 0, 0, 0] } });
+    check('ledger hours are merged into the history',
+          JSON.parse(storage.energy_ledger).map(function(h) { return [h.hour, h.battery, h.charging, h.frames,
+                                                                      h.messages, h.message_bytes, h.vibes,
+                                                                      h.disconnects]; }),
+          [[3600, 100, false, 300, 3, 300, 1, 0], [7200, 40, true, 5, 1, 9, 0, 0]]);
+
+    sent = phone.sent.length;
+    phone.emit('ready', { type: 'ready' });
+    check('then not within the interval', phone.sent.length, sent);
+  });
+}
+
+httpServer.listen(0, '127.0.0.1', function() {
+  server.port = httpServer.address().port;
+  run().then(function() {
+    httpServer.close();
+    console.log(failures ? failures + ' failed' : 'all passed');
+    process.exit(failures ? 1 : 0);
+  }, function(err) {
+    console.error(err);
+    process.exit(1);
+  });
+});
@@ -0,0 +1,223 @@
+// Replays an event trace recorded by src/trace.c against the watchface on the host stub, on the
+// virtual clock, so a day of events takes milliseconds. The persist snapshot at the start of the
+// trace is restored before the face launches. Reports heap, allocations, time spent in each kind
+// of handler and a hash of the final layer tree, taken where the session ended (or a few seconds
+// after its last event when it did not end cleanly), so two builds can be compared on identical
+// input.
+//
+//   replay <trace.bin>
+#include "pebble_stub.h"
+#include "../src/trace.h"
+
+// the trace itself is not app heap
+#undef malloc
+#undef free
+
+void handle_init(void);
+void handle_deinit(void);
+
+#define SETTLE_MS 5000      // without a TRACE_END, let the last animations land before hashing
+#define MAX_GROUP 16        // tuples delivered as one AppMessage
+
+typedef struct {
+  const uint8_t *at;
+  const uint8_t *end;
+} Reader;
+
+static bool read_u8(Reader *r, uint8_t *out) {
+  if (r->at >= r->end) return false;
+  *out = *r->at++;
+  return true;
+}
+
+static bool read_varint(Reader *r, uint32_t *out) {
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    uint8_t byte;
+    if (!read_u8(r, &byte)) return false;
+    value |= (uint32_t) (byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *out = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool read_u16(Reader *r, uint16_t *out) {
+  uint8_t lo, hi;
+  if (!read_u8(r, &lo) || !read_u8(r, &hi)) return false;
+  *out = lo | hi << 8;
+  return true;
+}
+
+// u8 key, u16 length and that many value bytes, left in place
+static bool read_value(Reader *r, uint8_t *key, uint8_t *type, const uint8_t **value, uint16_t *length) {
+  if (!read_u8(r, key) || (type && !read_u8(r, type)) || !read_u16(r, length) || r->at + *length > r->end) {
+    return false;
+  }
+  *value = r->at;
+  r->at += *length;
+  return true;
+}
+
+static Tuplet tuplet_from(uint32_t key, uint8_t type, const uint8_t *data, uint16_t length) {
+  switch (type) {
+    case TUPLE_CSTRING:
+      return (Tuplet) { .type = TUPLE_CSTRING, .key = key, .cstring = { .data = (const char *) data, .length = length } };
+    case TUPLE_BYTE_ARRAY:
+      return (Tuplet) { .type = TUPLE_BYTE_ARRAY, .key = key, .bytes = { .data = data, .length = length } };
+    default: {
+      uint32_t storage = 0;
+      memcpy(&storage, data, length > sizeof(storage) ? sizeof(storage) : length);
+      return (Tuplet) { .type = type, .key = key, .integer = { .storage = storage, .width = length } };
+    }
+  }
+}
+
+static uint8_t *read_file(const char *path, size_t *size) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return NULL;
+  fseek(f, 0, SEEK_END);
+  long length = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *data = malloc(length > 0 ? length : 1);
+  *size = fread(data, 1, length, f);
+  fclose(f);
+  return data;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <trace.bin>\n", argv[0]);
+    return 2;
+  }
+  setenv("TZ", "UTC", 1);
+  tzset();
+  stub_set_log_enabled(getenv("REPLAY_LOG") != NULL);
+
+  size_t size = 0;
+  uint8_t *events = read_file(argv[1], &size);
+  if (events == NULL || size < 7 || events[0] != 'W' || events[1] != 'T' || events[2] != TRACE_VERSION) {
+    fprintf(stderr, "%s: not a version %d trace\n", argv[1], TRACE_VERSION);
+    return 2;
+  }
+  uint32_t start = events[3] | events[4] << 8 | events[5] << 16 | (uint32_t) events[6] << 24;
+
+  stub_reset((time_t) start);
+  struct timespec wall_start, wall_end;
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+  // the storage the recorded session started from
+  Reader r = { events + 7, events + size };
+  uint32_t counts[TRACE_END + 1] = { 0 };
+  while (r.at < r.end && *r.at == TRACE_PERSIST) {
+    uint32_t delta;
+    uint8_t key;
+    const uint8_t *value;
+    uint16_t length;
+    r.at++;
+    if (!read_varint(&r, &delta) || !read_value(&r, &key, NULL, &value, &length)) break;
+    persist_write_data(key, value, length);
+    counts[TRACE_PERSIST]++;
+  }
+
+  handle_init();
+
+  uint64_t at = 0;
+  bool ended = false;
+  uint8_t kind;
+  while (!ended && read_u8(&r, &kind)) {
+    uint32_t delta;
+    if (!read_varint(&r, &delta)) break;
+    at += delta;
+    if (at > stub_now_ms()) stub_advance((uint32_t) (at - stub_now_ms()));
+
+    if (kind < ARRAY_LENGTH(counts)) counts[kind]++;
+    switch (kind) {
+      case TRACE_TICK:
+        break; // the stub raises ticks itself as the clock crosses the minute
+      case TRACE_BATTERY: {
+        uint8_t percent, flags;
+        if (!read_u8(&r, &percent) || !read_u8(&r, &flags)) goto truncated;
+        stub_set_battery((BatteryChargeState) { percent, flags & 1, (flags & 2) != 0 });
+        break;
+      }
+      case TRACE_BLUETOOTH: {
+        uint8_t connected;
+        if (!read_u8(&r, &connected)) goto truncated;
+        stub_set_bluetooth(connected);
+        break;
+      }
+      case TRACE_TUPLE: {
+        Tuplet group[MAX_GROUP];
+        uint8_t count = 0;
+        for (;;) {
+          uint8_t key, type;
+          const uint8_t *value;
+          uint16_t length;
+          if (!read_value(&r, &key, &type, &value, &length)) goto truncated;
+          if (count < MAX_GROUP) {
+            Tuplet tuplet = tuplet_from(key, type, value, length); // Tuplet has const members
+            memcpy(&group[count++], &tuplet, sizeof(tuplet));
+          }
+
+          // tuples recorded at the same instant arrived in one message
+          const uint8_t *peek = r.at;
+          uint32_t next_delta;
+          if (r.at < r.end && *r.at == TRACE_TUPLE) {
+            r.at++;
+            if (read_varint(&r, &next_delta) && next_delta == 0) {
+              counts[TRACE_TUPLE]++;
+              continue;
+            }
+          }
+          r.at = peek;
+          break;
+        }
+        stub_deliver_message(group, count);
+        break;
+      }
+      case TRACE_END:
+        ended = true;
+        break;
+      default:
+        fprintf(stderr, "unknown event kind %d\n", kind);
+        goto truncated;
+    }
+  }
+  goto done;
+
+truncated:
+  fprintf(stderr, "trace truncated or corrupt at byte %ld\n", (long) (r.at - events));
+
+done:
+  if (!ended) stub_advance(SETTLE_MS);
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+  uint32_t hash = stub_state_hash();
+  size_t heap_peak = stub_counters.heap_peak;
+  StubCounters counters = stub_counters;
+  handle_deinit();
+  free(events);
+
+  double wall_ms = (wall_end.tv_sec - wall_start.tv_sec) * 1e3 + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e6;
+  double virtual_ms = (double) stub_now_ms();
+
+  printf("replayed %.1f h of events (%u persist keys, %u ticks, %u battery, %u bluetooth, %u tuples) in %.1f ms, "
+         "%.0fx real time%s\n", virtual_ms / 3.6e6, counts[TRACE_PERSIST], counts[TRACE_TICK], counts[TRACE_BATTERY],
+         counts[TRACE_BLUETOOTH], counts[TRACE_TUPLE], wall_ms, wall_ms > 0 ? virtual_ms / wall_ms : 0,
+         ended ? "" : ", no clean exit");
+  printf("heap peak %zu bytes, %u allocations (%llu bytes), %u resource loads, %u redraws\n",
+         heap_peak, counters.allocs, (unsigned long long) counters.alloc_bytes, counters.resource_loads,
+         counters.redraws);
+  printf("\n%-10s %8s %12s %10s %10s\n", "handler", "calls", "total us", "avg us", "max us");
+  for (int h = 0; h < STUB_HANDLER_COUNT; h++) {
+    const StubHandlerStats *stats = &stub_handler_stats[h];
+    printf("%-10s %8u %12.1f %10.2f %10.2f\n", STUB_HANDLER_NAMES[h], stats->calls, stats->total_ns / 1e3,
+           stats->calls ? stats->total_ns / 1e3 / stats->calls : 0, stats->max_ns / 1e3);
+  }
+  printf("\nREPLAY state_hash=0x%08x heap_peak=%zu allocs=%u resource_loads=%u redraws=%u\n",
+         hash, heap_peak, counters.allocs, counters.resource_loads, counters.redraws);
+  return 0;
+}
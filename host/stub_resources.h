@@ -0,0 +1,24 @@
+// Resource table shared by the stub and the generated resources.auto.c.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  STUB_RESOURCE_BITMAP,
+  STUB_RESOURCE_FONT,
+  STUB_RESOURCE_RAW,
+} StubResourceKind;
+
+typedef struct {
+  uint32_t id;
+  const char *name;
+  StubResourceKind kind;
+  const char *path;       // relative to the repository root
+  int16_t width;          // bitmaps only
+  int16_t height;
+  size_t file_size;
+} StubResource;
+
+extern const StubResource STUB_RESOURCES[];
+extern const size_t STUB_RESOURCE_COUNT;
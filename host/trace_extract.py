@@ -0,0 +1,42 @@
+"""Turn app log output containing "TRACE <hex>" lines into a binary trace.
+
+Usage: trace_extract.py <log file or -> <trace.bin> [session]
+
+Works on `pebble logs` output and on the host stub's stderr alike. A "TRACE start"
+line begins a new session; session picks one by its index in the log (negative from
+the end), the last by default.
+"""
+
+import re
+import sys
+
+LINE = re.compile(r'TRACE (start|[0-9a-f]+)$')
+
+
+def extract(lines, session=-1):
+    sessions = []
+    for line in lines:
+        match = LINE.search(line.rstrip())
+        if not match:
+            continue
+        if match.group(1) == 'start':
+            sessions.append(b'')
+        elif sessions:
+            sessions[-1] += bytes.fromhex(match.group(1))
+    try:
+        return sessions[session]
+    except IndexError:
+        return b''
+
+
+def main(source, target, session=-1):
+    stream = sys.stdin if source == '-' else open(source)
+    trace = extract(stream, session)
+    if not trace:
+        sys.exit('no TRACE lines found')
+    with open(target, 'wb') as f:
+        f.write(trace)
+
+
+if __name__ == '__main__':
+    main(sys.argv[1], sys.argv[2], *(int(arg) for arg in sys.argv[3:4]))
@@ -0,0 +1,38 @@
+#include <pebble.h>
+#include "anim_policy.h"
+
+// battery levels, in percent, at or below which AUTO steps down
+#define ANIM_BATTERY_REDUCED 30
+#define ANIM_BATTERY_OFF 10
+
+static AnimSetting s_setting = ANIM_SETTING_AUTO;
+static SlideQuality s_battery_quality = SLIDE_QUALITY_FULL;
+
+static void anim_policy_apply(void) {
+  slide_layer_set_quality(anim_policy_quality());
+}
+
+void anim_policy_set_setting(uint8_t setting) {
+  s_setting = setting <= ANIM_SETTING_OFF ? (AnimSetting) setting : ANIM_SETTING_AUTO;
+  anim_policy_apply();
+}
+
+void anim_policy_set_battery(BatteryChargeState charge_state) {
+  if (charge_state.is_charging || charge_state.charge_percent > ANIM_BATTERY_REDUCED) {
+    s_battery_quality = SLIDE_QUALITY_FULL;
+  } else if (charge_state.charge_percent > ANIM_BATTERY_OFF) {
+    s_battery_quality = SLIDE_QUALITY_REDUCED;
+  } else {
+    s_battery_quality = SLIDE_QUALITY_OFF;
+  }
+  anim_policy_apply();
+}
+
+SlideQuality anim_policy_quality(void) {
+  switch (s_setting) {
+    case ANIM_SETTING_FULL: return SLIDE_QUALITY_FULL;
+    case ANIM_SETTING_REDUCED: return SLIDE_QUALITY_REDUCED;
+    case ANIM_SETTING_OFF: return SLIDE_QUALITY_OFF;
+    default: return s_battery_quality;
+  }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <pebble.h>
+#include "slide_layer.h"
+
+
+// Decides how much the digit transitions may cost and hands it to slide_layer_set_quality().
+// Left on AUTO it follows the battery: full slides while charging or above
+// ANIM_BATTERY_REDUCED percent, reduced ones down to ANIM_BATTERY_OFF, cuts below that. The
+// user can pin a quality instead through ANIMATION_KEY.
+
+// ANIMATION_KEY values, as the phone sends them
+typedef enum {
+  ANIM_SETTING_AUTO = 0,
+  ANIM_SETTING_FULL = 1,
+  ANIM_SETTING_REDUCED = 2,
+  ANIM_SETTING_OFF = 3
+} AnimSetting;
+
+// unknown values count as AUTO
+void anim_policy_set_setting(uint8_t setting);
+
+void anim_policy_set_battery(BatteryChargeState charge_state);
+
+SlideQuality anim_policy_quality(void);
@@ -0,0 +1,61 @@
+#include <pebble.h>
+#define ATLAS_TABLE_IMPLEMENTATION
+#include "atlas.h"
+#include "perf.h"
+
+// loaded sheets and their reference counts, one slot per family
+static GBitmap *s_sheets[ATLAS_COUNT];
+static uint8_t s_refs[ATLAS_COUNT];
+
+void atlas_retain(AtlasId atlas) {
+  if (s_refs[atlas]++ > 0) return;
+
+  s_sheets[atlas] = gbitmap_create_with_resource(ATLAS_SHEETS[atlas].resource_id);
+  perf_resource_load();
+}
+
+void atlas_release(AtlasId atlas) {
+  if (s_refs[atlas] == 0 || --s_refs[atlas] > 0) return;
+
+  gbitmap_destroy(s_sheets[atlas]);
+  s_sheets[atlas] = NULL;
+}
+
+GBitmap* atlas_create_bitmap(AtlasId atlas, uint8_t index) {
+  const AtlasSheet *sheet = &ATLAS_SHEETS[atlas];
+  if (s_sheets[atlas] == NULL || index >= sheet->count) return NULL;
+
+  return gbitmap_create_as_sub_bitmap(s_sheets[atlas], ATLAS_RECTS[sheet->first + index]);
+}
+
+GSize atlas_member_size(AtlasId atlas, uint8_t index) {
+  const AtlasSheet *sheet = &ATLAS_SHEETS[atlas];
+  if (index >= sheet->count) return GSize(0, 0);
+
+  return ATLAS_RECTS[sheet->first + index].size;
+}
+
+void atlas_set_member(GBitmap *view, AtlasId atlas, uint8_t index) {
+  const AtlasSheet *sheet = &ATLAS_SHEETS[atlas];
+  if (view == NULL || index >= sheet->count) return;
+
+#ifdef PBL_PLATFORM_BASALT
+  gbitmap_set_bounds(view, ATLAS_RECTS[sheet->first + index]);
+#else
+  view->bounds = ATLAS_RECTS[sheet->first + index];
+#endif
+}
+
+void atlas_set_member_slice(GBitmap *view, AtlasId atlas, uint8_t index, GRect slice) {
+  const AtlasSheet *sheet = &ATLAS_SHEETS[atlas];
+  if (view == NULL || index >= sheet->count) return;
+
+  GRect member = ATLAS_RECTS[sheet->first + index];
+  slice.origin.x += member.origin.x;
+  slice.origin.y += member.origin.y;
+#ifdef PBL_PLATFORM_BASALT
+  gbitmap_set_bounds(view, slice);
+#else
+  view->bounds = slice;
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+  
+#include <pebble.h>  
+
+
+// one packed sprite sheet resource and where its members sit in ATLAS_RECTS
+typedef struct {
+  uint32_t resource_id;
+  uint8_t  first;
+  uint8_t  count;
+} AtlasSheet;
+
+#include "atlas_table.h"
+
+
+// loads the sheet on first retain and frees it on the last release
+void atlas_retain(AtlasId atlas);
+
+void atlas_release(AtlasId atlas);
+
+// view of a single member sharing the sheet's pixels; free it with gbitmap_destroy
+// before the matching atlas_release
+GBitmap* atlas_create_bitmap(AtlasId atlas, uint8_t index);
+
+// size of a member, without the sheet having to be loaded
+GSize atlas_member_size(AtlasId atlas, uint8_t index);
+
+// points a view from atlas_create_bitmap at another member of the same sheet, without allocating
+void atlas_set_member(GBitmap *view, AtlasId atlas, uint8_t index);
+
+// as atlas_set_member, narrowed to slice (in the member's coordinates) to draw part of it
+void atlas_set_member_slice(GBitmap *view, AtlasId atlas, uint8_t index, GRect slice);
@@ -0,0 +1,118 @@
+// Generated by tools/atlas.py -- do not edit.
+#pragma once
+
+typedef enum {
+  ATLAS_DIGITS,
+  ATLAS_BATTERY,
+  ATLAS_BLUETOOTH,
+  ATLAS_TEMPERATURE,
+  ATLAS_COUNT
+} AtlasId;
+
+enum {
+  ATLAS_DIGITS_0,
+  ATLAS_DIGITS_1,
+  ATLAS_DIGITS_2,
+  ATLAS_DIGITS_3,
+  ATLAS_DIGITS_4,
+  ATLAS_DIGITS_5,
+  ATLAS_DIGITS_6,
+  ATLAS_DIGITS_7,
+  ATLAS_DIGITS_8,
+  ATLAS_DIGITS_9,
+  ATLAS_DIGITS_COUNT
+};
+
+enum {
+  ATLAS_BATTERY_000_010,
+  ATLAS_BATTERY_010_020,
+  ATLAS_BATTERY_020_030,
+  ATLAS_BATTERY_030_040,
+  ATLAS_BATTERY_040_050,
+  ATLAS_BATTERY_050_060,
+  ATLAS_BATTERY_060_070,
+  ATLAS_BATTERY_070_080,
+  ATLAS_BATTERY_080_090,
+  ATLAS_BATTERY_090_100,
+  ATLAS_BATTERY_CHARGING,
+  ATLAS_BATTERY_COUNT
+};
+
+enum {
+  ATLAS_BLUETOOTH_ON,
+  ATLAS_BLUETOOTH_OFF,
+  ATLAS_BLUETOOTH_COUNT
+};
+
+enum {
+  ATLAS_TEMPERATURE_0,
+  ATLAS_TEMPERATURE_1,
+  ATLAS_TEMPERATURE_2,
+  ATLAS_TEMPERATURE_3,
+  ATLAS_TEMPERATURE_4,
+  ATLAS_TEMPERATURE_5,
+  ATLAS_TEMPERATURE_6,
+  ATLAS_TEMPERATURE_7,
+  ATLAS_TEMPERATURE_8,
+  ATLAS_TEMPERATURE_9,
+  ATLAS_TEMPERATURE_MINUS,
+  ATLAS_TEMPERATURE_DEGREE,
+  ATLAS_TEMPERATURE_TILDE,
+  ATLAS_TEMPERATURE_COUNT
+};
+
+#define ATLAS_TEMPERATURE_TOP 5
+
+#ifdef ATLAS_TABLE_IMPLEMENTATION
+
+static const GRect ATLAS_RECTS[] = {
+  // digits
+  {{0, 0}, {28, 70}},
+  {{0, 70}, {28, 70}},
+  {{0, 140}, {28, 70}},
+  {{0, 210}, {28, 70}},
+  {{0, 280}, {28, 70}},
+  {{0, 350}, {28, 70}},
+  {{0, 420}, {28, 70}},
+  {{0, 490}, {28, 70}},
+  {{0, 560}, {28, 70}},
+  {{0, 630}, {28, 70}},
+  // battery
+  {{0, 0}, {35, 11}},
+  {{0, 11}, {35, 11}},
+  {{0, 22}, {35, 11}},
+  {{0, 33}, {35, 11}},
+  {{0, 44}, {35, 11}},
+  {{0, 55}, {35, 11}},
+  {{0, 66}, {35, 11}},
+  {{0, 77}, {35, 11}},
+  {{0, 88}, {35, 11}},
+  {{0, 99}, {35, 11}},
+  {{0, 110}, {35, 11}},
+  // bluetooth
+  {{0, 0}, {11, 18}},
+  {{0, 18}, {11, 18}},
+  // temperature
+  {{0, 0}, {10, 24}},
+  {{10, 0}, {5, 24}},
+  {{15, 0}, {9, 24}},
+  {{24, 0}, {9, 24}},
+  {{33, 0}, {9, 24}},
+  {{42, 0}, {9, 24}},
+  {{51, 0}, {9, 24}},
+  {{60, 0}, {8, 24}},
+  {{68, 0}, {9, 24}},
+  {{77, 0}, {9, 24}},
+  {{86, 0}, {5, 24}},
+  {{91, 0}, {9, 24}},
+  {{100, 0}, {13, 24}},
+};
+
+static const AtlasSheet ATLAS_SHEETS[ATLAS_COUNT] = {
+  { RESOURCE_ID_ATLAS_DIGITS, 0, 10 },
+  { RESOURCE_ID_ATLAS_BATTERY, 10, 11 },
+  { RESOURCE_ID_ATLAS_BLUETOOTH, 21, 2 },
+  { RESOURCE_ID_ATLAS_TEMPERATURE, 23, 13 },
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include <pebble.h>
+#include "forecast.h"
+
+// next to WEATHER_CACHE_KEY (0x10) in main.c
+#define FORECAST_PERSIST_KEY 0x11
+#define FORECAST_CACHE_VERSION 2
+
+typedef struct {
+  int8_t  temperature;
+  uint8_t icon;
+  uint8_t condition;
+} ForecastHour;
+
+typedef struct {
+  uint8_t      version;   // FORECAST_CACHE_VERSION
+  uint8_t      unit;      // WeatherUnit
+  uint8_t      count;     // hours from start on
+  uint32_t     start;     // start of hours[0]
+  ForecastHour hours[FORECAST_HOURS];
+} ForecastCache;
+
+static ForecastCache s_forecast;
+
+void forecast_load(void) {
+  if (persist_read_data(FORECAST_PERSIST_KEY, &s_forecast, sizeof(s_forecast)) != sizeof(s_forecast) ||
+      s_forecast.version != FORECAST_CACHE_VERSION || s_forecast.count > FORECAST_HOURS) {
+    memset(&s_forecast, 0, sizeof(s_forecast));
+  }
+}
+
+bool forecast_receive(const uint8_t *data, uint16_t length) {
+  if (length < FORECAST_HEADER_SIZE || data[0] != FORECAST_PROTOCOL_VERSION) return false;
+
+  uint8_t count = data[6];
+  if (count > FORECAST_HOURS || length < FORECAST_HEADER_SIZE + count * FORECAST_ENTRY_SIZE) return false;
+
+  s_forecast.version = FORECAST_CACHE_VERSION;
+  s_forecast.start = data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t) data[4] << 24);
+  s_forecast.unit = data[5];
+  s_forecast.count = count;
+  for (int i = 0; i < count; i++) {
+    const uint8_t *entry = &data[FORECAST_HEADER_SIZE + i * FORECAST_ENTRY_SIZE];
+    s_forecast.hours[i] = (ForecastHour) {
+      .temperature = (int8_t) entry[0],
+      .icon = entry[1],
+      .condition = entry[2]
+    };
+  }
+  persist_write_data(FORECAST_PERSIST_KEY, &s_forecast, sizeof(s_forecast));
+  return true;
+}
+
+bool forecast_at(time_t now, WeatherReport *report, time_t *hour_start) {
+  if (s_forecast.count == 0 || now < (time_t) s_forecast.start) return false;
+  uint32_t index = (now - s_forecast.start) / FORECAST_HOUR_S;
+  if (index >= s_forecast.count) return false;
+
+  const ForecastHour *hour = &s_forecast.hours[index];
+  report->temperature = hour->temperature;
+  report->unit = s_forecast.unit;
+  report->icon = hour->icon;
+  report->condition = hour->condition;
+  *hour_start = s_forecast.start + index * FORECAST_HOUR_S;
+  return true;
+}
+
+time_t forecast_until(void) {
+  return s_forecast.count ? (time_t) s_forecast.start + s_forecast.count * FORECAST_HOUR_S : 0;
+}
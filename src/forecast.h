@@ -0,0 +1,32 @@
+#pragma once
+
+#include <pebble.h>
+#include "weather.h"
+
+
+// Hourly forecast the phone sends under FORECAST_KEY along with the current weather, so the
+// panel can move on hour by hour without asking:
+//   u8 version, u32 start (time of the first hour, little endian), u8 unit, u8 count,
+//   count x { s8 temperature, u8 icon, u8 condition }
+// The hours are the phone's local hours, so in a timezone with a half- or quarter-hour offset
+// start is not a whole UTC hour; the watch counts its forecast hours from start and never from
+// time() alone. The forecast is kept in persist storage as received, a new one replacing it.
+#define FORECAST_PROTOCOL_VERSION 1
+#define FORECAST_HOURS 24
+#define FORECAST_HOUR_S (60 * 60)
+#define FORECAST_HEADER_SIZE 7
+#define FORECAST_ENTRY_SIZE 3
+#define FORECAST_PAYLOAD_MAX (FORECAST_HEADER_SIZE + FORECAST_HOURS * FORECAST_ENTRY_SIZE)
+
+// restores the forecast saved by the last forecast_receive
+void forecast_load(void);
+
+// takes a FORECAST_KEY payload and saves it; false when it is not one
+bool forecast_receive(const uint8_t *data, uint16_t length);
+
+// the forecast for the hour containing now and when that hour started; false when there is none
+// that far
+bool forecast_at(time_t now, WeatherReport *report, time_t *hour_start);
+
+// end of the last forecast hour, 0 without a forecast
+time_t forecast_until(void);
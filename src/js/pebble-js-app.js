@@ -78,110 +78,309 @@ if (options === null) options = { "use_gps" : "true",
 					 			  "hidebatt" : "false",
                                   "hidedate" : "false",
                                   "hidedegree" : "false",
-								  "blink" : "false"};
+								  "blink" : "false",
+                                  "animation" : "auto"};
 
-function getWeatherFromLatLong(latitude, longitude) {
-  var response;
-  var woeid = -1;
-  var query = encodeURI("select woeid from geo.placefinder where text=\""+latitude+","+longitude + "\" and gflags=\"R\"");
-  var url = "http://query.yahooapis.com/v1/public/yql?q=" + query + "&format=json";
+var YQL_URL = "http://query.yahooapis.com/v1/public/yql";
+// a refresh that gets no answer in this long is abandoned; the watch asks again later
+var REQUEST_TIMEOUT = 15000;
+// a place keeps its WOEID; re-resolve now and then in case Yahoo remaps it
+var WOEID_MAX_AGE = 7 * 24 * 3600 * 1000;
+var WOEID_CACHE_SIZE = 8;
+
+// One refresh at a time: a request arriving mid-refresh runs once the current one is done.
+var refreshing = false;
+var refreshAgain = false;
+
+// WOEID by rounded lat/long ("ll:51.51,-0.13", about a kilometre) or location name
+// ("name:london"), so a refresh from a known place is a single weather request.
+var woeidCache = JSON.parse(localStorage.getItem('woeid_cache')) || {};
+
+function cachedWoeid(key) {
+  var entry = woeidCache[key];
+  return (entry && Date.now() - entry.time < WOEID_MAX_AGE) ? entry.woeid : null;
+}
+
+function storeWoeid(key, woeid) {
+  woeidCache[key] = { "woeid": woeid, "time": Date.now() };
+  var keys = Object.keys(woeidCache);
+  if (keys.length > WOEID_CACHE_SIZE) {
+    keys.sort(function(a, b) { return woeidCache[a].time - woeidCache[b].time; });
+    for (var i = 0; i < keys.length - WOEID_CACHE_SIZE; i++) delete woeidCache[keys[i]];
+  }
+  localStorage.setItem('woeid_cache', JSON.stringify(woeidCache));
+}
+
+// GET a YQL query; callback(response) on success, callback(null) on any failure or timeout
+function yqlRequest(query, callback) {
+  var url = YQL_URL + "?q=" + encodeURI(query) + "&format=json";
+  var done = false;
   var req = new XMLHttpRequest();
+  var finish = function(response) {
+    if (done) return;
+    done = true;
+    clearTimeout(timer);
+    callback(response);
+  };
+  var timer = setTimeout(function() {
+    console.log("request timed out");
+    req.abort();
+    finish(null);
+  }, REQUEST_TIMEOUT);
+
   req.open('GET', url, true);
   req.onload = function(e) {
-    if (req.readyState == 4) {
-      if (req.status == 200) {
+    if (req.readyState != 4) return;
+    var response = null;
+    if (req.status == 200) {
+      try {
         response = JSON.parse(req.responseText);
-        if (response) {
-          woeid = response.query.results.Result.woeid;
-          getWeatherFromWoeid(woeid);
-        }
-      } else {
-        console.log("Error");
+      } catch (err) {
+        response = null;
       }
     }
+    if (!response) console.log("Error");
+    finish(response);
+  };
+  req.onerror = function(e) {
+    console.log("Error");
+    finish(null);
   };
   req.send(null);
 }
 
-function getWeatherFromLocation(location_name) {
-  var response;
-  var woeid = -1;
+function refreshDone() {
+  refreshing = false;
+  if (refreshAgain) {
+    refreshAgain = false;
+    updateWeather();
+  }
+}
 
-  var query = encodeURI("select woeid from geo.places(1) where text=\"" + location_name + "\"");
-  var url = "http://query.yahooapis.com/v1/public/yql?q=" + query + "&format=json";
-  var req = new XMLHttpRequest();
-  req.open('GET', url, true);
-  req.onload = function(e) {
-    if (req.readyState == 4) {
-      if (req.status == 200) {
-        // console.log(req.responseText);
-        response = JSON.parse(req.responseText);
-        if (response) {
-          woeid = response.query.results.place.woeid;
-          getWeatherFromWoeid(woeid);
-        }
-      } else {
-        console.log("Error");
-      }
+// WOEID from the cache, or from the lookup query when the place is new or the entry too old
+function resolveWoeid(key, query, extract) {
+  var woeid = cachedWoeid(key);
+  if (woeid) {
+    getWeatherFromWoeid(woeid);
+    return;
+  }
+  yqlRequest(query, function(response) {
+    try {
+      woeid = response && extract(response.query.results);
+    } catch (err) {
+      woeid = null;
     }
-  };
-  req.send(null);
+    if (!woeid) {
+      refreshDone();
+      return;
+    }
+    storeWoeid(key, woeid);
+    getWeatherFromWoeid(woeid);
+  });
+}
+
+function getWeatherFromLatLong(latitude, longitude) {
+  resolveWoeid("ll:" + latitude.toFixed(2) + "," + longitude.toFixed(2),
+               "select woeid from geo.placefinder where text=\"" + latitude + "," + longitude + "\" and gflags=\"R\"",
+               function(results) { return results.Result.woeid; });
+}
+
+function getWeatherFromLocation(location_name) {
+  resolveWoeid("name:" + location_name.toLowerCase(),
+               "select woeid from geo.places(1) where text=\"" + location_name + "\"",
+               function(results) { return results.place.woeid; });
 }
 
 function getWeatherFromWoeid(woeid) {
   var celsius = options['units'] == 'celsius';
-  var query = encodeURI("select item.condition from weather.forecast where woeid = " + woeid +
-                        " and u = " + (celsius ? "\"c\"" : "\"f\""));
-  var url = "http://query.yahooapis.com/v1/public/yql?q=" + query + "&format=json";
+  var query = "select item.condition, item.forecast from weather.forecast where woeid = " + woeid +
+              " and u = " + (celsius ? "\"c\"" : "\"f\"");
 
-  var response;
-  var req = new XMLHttpRequest();
-  req.open('GET', url, true);
-  req.onload = function(e) {
-    if (req.readyState == 4) {
-      if (req.status == 200) {
-        response = JSON.parse(req.responseText);
+  yqlRequest(query, function(response) {
+    var condition = null;
+    var days = [];
+    try {
+      // selecting item.forecast gives one channel per forecast day, each with the condition
+      var channels = [].concat(response.query.results.channel);
+      condition = channels[0].item.condition;
+      days = channels.map(function(channel) { return channel.item.forecast; });
+    } catch (err) {
+      condition = null;
+    }
 
-		//var temperature, high, low, code, humidity, city, sunrise, sunset;
-
-        if (response) {
-          var condition = response.query.results.channel.item.condition;
-			//var location = response.location;
-			
-			
-			
-			
-          temperature = condition.temp + (celsius ? "\u00B0" : "\u00B0");
-          code = condition.code;
-      //    name = location;
-          city = condition.text;
-			
-          icon = imageId[condition.code];
-           console.log("temp " + temperature);
-           console.log("icon " + icon);
-//           console.log("condition " + condition.text);
-      //     console.log("name " + city);
-           console.log("city " + condition.text);
-			
-          Pebble.sendAppMessage({  
-			"temperature": temperature,
-            "icon": icon,
-            "city": condition.text,
-
-            "invert_color" : (options["invert_color"] == "true" ? 1 : 0),
-			"bluetoothvibe" : (options["bluetoothvibe"] == "true" ? 1 : 0),
-            "hourlyvibe" : (options["hourlyvibe"] == "true" ? 1 : 0),
-          });
-        }
-      } else {
-        console.log("Error");
-      }
+    if (condition) {
+      var code = parseInt(condition.code, 10);
+      var icon = imageId[code];
+      if (icon === undefined) icon = NA;
+      console.log("temp " + condition.temp + " code " + code + " icon " + icon);
+
+      var message = settingsChanges();
+      message["weather"] = packWeather(parseInt(condition.temp, 10), celsius, icon, code);
+      message["forecast"] = packForecast(hourlyForecast(parseInt(condition.temp, 10), code, days), celsius);
+      Pebble.sendAppMessage(message, function(e) {
+        localStorage.setItem('sent_settings', JSON.stringify(settingsMessage()));
+      });
     }
+    refreshDone();
+  });
+}
+
+// WEATHER_PROTOCOL_VERSION in src/weather.h
+var WEATHER_PROTOCOL_VERSION = 1;
+// Yahoo codes above this (3200, "not available") go out as WEATHER_CONDITION_UNKNOWN
+var LAST_CONDITION = 47;
+var CONDITION_UNKNOWN = 255;
+
+// u8 version, s16 temperature (little endian), u8 unit, u8 icon, u8 condition
+function packWeather(temperature, celsius, icon, code) {
+  if (isNaN(temperature)) temperature = 0;
+  var t = temperature & 0xFFFF;
+  return [WEATHER_PROTOCOL_VERSION, t & 0xFF, (t >> 8) & 0xFF, celsius ? 1 : 0, icon,
+          (code >= 0 && code <= LAST_CONDITION) ? code : CONDITION_UNKNOWN];
+}
+
+// FORECAST_PROTOCOL_VERSION and FORECAST_HOURS in src/forecast.h
+var FORECAST_PROTOCOL_VERSION = 1;
+var FORECAST_HOURS = 24;
+// Yahoo only forecasts whole days, so the hours in between follow the usual daily swing: the
+// low around dawn, the high mid afternoon
+var LOW_HOUR = 5;
+var HIGH_HOUR = 15;
+var NIGHT_ICON = {};
+NIGHT_ICON[CLEAR_DAY] = CLEAR_NIGHT;
+NIGHT_ICON[PARTLY_CLOUDY_DAY] = PARTLY_CLOUDY_NIGHT;
+
+function isNight(hour) {
+  return hour < 6 || hour >= 20;
+}
+
+function hourlyTemperature(day, hour) {
+  var low = parseInt(day.low, 10);
+  var high = parseInt(day.high, 10);
+  // 0 at the low, 1 at the high
+  var rise = hour >= LOW_HOUR && hour < HIGH_HOUR ? (hour - LOW_HOUR) / (HIGH_HOUR - LOW_HOUR)
+                                                  : 1 - ((hour - HIGH_HOUR + 24) % 24) / (24 - HIGH_HOUR + LOW_HOUR);
+  return Math.round(low + (high - low) * (1 - Math.cos(Math.PI * rise)) / 2);
+}
+
+// the next FORECAST_HOURS local hours from the start of this one, which shows the current
+// condition; the watch counts the hours from start, whatever the timezone's offset
+function hourlyForecast(temperature, code, days) {
+  var start = new Date();
+  start.setMinutes(0, 0, 0);
+  var hours = [];
+  var dayIndex = 0;
+  for (var i = 0; i < FORECAST_HOURS; i++) {
+    var hour = new Date(start.getTime() + i * 3600000).getHours();
+    if (i > 0 && hour === 0) dayIndex++;
+    var day = days[dayIndex];
+    if (i > 0 && !day) break;
+
+    var hourCode = i === 0 ? code : parseInt(day.code, 10);
+    var icon = imageId[hourCode];
+    if (icon === undefined) icon = NA;
+    if (isNight(hour) && NIGHT_ICON[icon] !== undefined) icon = NIGHT_ICON[icon];
+    hours.push({ "temperature": i === 0 ? temperature : hourlyTemperature(day, hour), "icon": icon, "code": hourCode });
+  }
+  return { "start": Math.floor(start.getTime() / 1000), "hours": hours };
+}
+
+// u8 version, u32 start (little endian), u8 unit, u8 count, count x { s8 temperature, u8 icon, u8 condition }
+function packForecast(forecast, celsius) {
+  var data = [FORECAST_PROTOCOL_VERSION,
+              forecast.start & 0xFF, (forecast.start >>> 8) & 0xFF, (forecast.start >>> 16) & 0xFF,
+              (forecast.start >>> 24) & 0xFF, celsius ? 1 : 0, forecast.hours.length];
+  forecast.hours.forEach(function(hour) {
+    var t = isNaN(hour.temperature) ? 0 : Math.max(-128, Math.min(127, hour.temperature));
+    data.push(t & 0xFF, hour.icon,
+              (hour.code >= 0 && hour.code <= LAST_CONDITION) ? hour.code : CONDITION_UNKNOWN);
+  });
+  return data;
+}
+
+// LEDGER_PROTOCOL_VERSION and the entry layout in src/ledger.h
+var LEDGER_PROTOCOL_VERSION = 1;
+var LEDGER_HEADER_SIZE = 6;
+var LEDGER_ENTRY_SIZE = 8;
+var LEDGER_CHARGING = 0x80;
+var LEDGER_BATTERY_UNKNOWN = 0xFF;
+// the watch keeps the last day; asking twice a day and keeping a week leaves no gaps
+var LEDGER_REQUEST_INTERVAL = 12 * 3600 * 1000;
+var LEDGER_KEEP_HOURS = 7 * 24;
+
+// u8 version, u32 start of the oldest hour (little endian), u8 count,
+// count x { u8 battery, u16 frames, u8 messages, u16 message bytes, u8 vibes, u8 disconnects }
+function unpackLedger(data) {
+  if (data.length < LEDGER_HEADER_SIZE || data[0] != LEDGER_PROTOCOL_VERSION) return null;
+  var start = data[1] + data[2] * 256 + data[3] * 65536 + data[4] * 16777216;
+  var hours = [];
+  for (var i = 0; i < data[5] && LEDGER_HEADER_SIZE + (i + 1) * LEDGER_ENTRY_SIZE <= data.length; i++) {
+    var at = LEDGER_HEADER_SIZE + i * LEDGER_ENTRY_SIZE;
+    var battery = data[at];
+    var known = battery != LEDGER_BATTERY_UNKNOWN;
+    hours.push({ "hour": start + i * 3600,
+                 "battery": known ? battery & ~LEDGER_CHARGING : null,
+                 "charging": known && (battery & LEDGER_CHARGING) !== 0,
+                 "frames": data[at + 1] + data[at + 2] * 256,
+                 "messages": data[at + 3],
+                 "message_bytes": data[at + 4] + data[at + 5] * 256,
+                 "vibes": data[at + 6],
+                 "disconnects": data[at + 7] });
+  }
+  return hours;
+}
+
+// the watch's hours merged into the stored history; a later copy of an hour replaces the earlier
+function storeLedger(hours) {
+  var byHour = {};
+  (JSON.parse(localStorage.getItem('energy_ledger')) || []).concat(hours).forEach(function(hour) {
+    byHour[hour.hour] = hour;
+  });
+  var history = Object.keys(byHour).map(function(key) { return byHour[key]; });
+  history.sort(function(a, b) { return a.hour - b.hour; });
+  localStorage.setItem('energy_ledger', JSON.stringify(history.slice(-LEDGER_KEEP_HOURS)));
+}
+
+// the interval counts from the last ledger that arrived, so a request the watch could not answer
+// is repeated at the next start; the value changes every time, so the watch's AppSync sees a new
+// request
+function requestLedger() {
+  var now = Date.now();
+  if (now - (parseInt(localStorage.getItem('ledger_received'), 10) || 0) < LEDGER_REQUEST_INTERVAL) return;
+  Pebble.sendAppMessage({ "ledger_request": Math.floor(now / 1000) });
+}
+
+// the config page's animation choices as the watch numbers them (AnimSetting in anim_policy.h);
+// options saved before there was a choice read as auto
+var ANIMATION_SETTINGS = { "auto" : 0, "full" : 1, "reduced" : 2, "off" : 3 };
+
+function settingsMessage() {
+  return {
+    "invert_color" : (options["invert_color"] == "true" ? 1 : 0),
+    "bluetoothvibe" : (options["bluetoothvibe"] == "true" ? 1 : 0),
+    "blink" : (options["blink"] == "true" ? 1 : 0),
+    "animation" : ANIMATION_SETTINGS[options["animation"]] || 0
   };
-  req.send(null);
+}
+
+// the settings the watch has not been sent yet; it keeps the rest in persist storage
+function settingsChanges() {
+  var sent = JSON.parse(localStorage.getItem('sent_settings')) || {};
+  var current = settingsMessage();
+  var changes = {};
+  for (var key in current) {
+    if (sent[key] !== current[key]) changes[key] = current[key];
+  }
+  return changes;
 }
 
 function updateWeather() {
+  if (refreshing) {
+    refreshAgain = true;
+    return;
+  }
+  refreshing = true;
+
   if (options['use_gps'] == "true") {
     window.navigator.geolocation.getCurrentPosition(locationSuccess,
                                                     locationError,
@@ -191,7 +390,9 @@ function updateWeather() {
   }
 }
 
-var locationOptions = { "timeout": 15000, "maximumAge": 60000 };
+// a fix up to half an hour old will do: the WOEID cache only needs to know roughly where we are,
+// and a cached fix spares the GPS
+var locationOptions = { "timeout": 15000, "maximumAge": 1800000 };
 
 function locationSuccess(pos) {
   var coordinates = pos.coords;
@@ -200,13 +401,25 @@ function locationSuccess(pos) {
 
 function locationError(err) {
   console.warn('location error (' + err.code + '): ' + err.message);
-  Pebble.sendAppMessage({
-    "temperature": 999,
-    "icon": 11
-  //  "city":        
-  });
+  // nothing to send: the watch keeps showing its cached weather and marks it stale as it ages
+  refreshDone();
 }
 
+// the watch asks for weather when its copy is due for a refresh, after reconnecting and when
+// an update was lost on the way
+Pebble.addEventListener('appmessage', function(e) {
+  if (e.payload.request) {
+    updateWeather();
+  }
+  if (e.payload.ledger) {
+    var hours = unpackLedger(e.payload.ledger);
+    if (hours) {
+      storeLedger(hours);
+      localStorage.setItem('ledger_received', Date.now());
+    }
+  }
+});
+
 Pebble.addEventListener('showConfiguration', function(e) {
   var uri = 'http://www.themapman.com/pebblewatch/widgetface.html?' +
     'use_gps=' + encodeURIComponent(options['use_gps']) +
@@ -214,7 +427,9 @@ Pebble.addEventListener('showConfiguration', function(e) {
     '&units=' + encodeURIComponent(options['units']) +
     '&invert_color=' + encodeURIComponent(options['invert_color']) +
     '&bluetoothvibe=' + encodeURIComponent(options['bluetoothvibe']) +
-	'&hourlyvibe=' + encodeURIComponent(options['hourlyvibe']);
+	'&hourlyvibe=' + encodeURIComponent(options['hourlyvibe']) +
+    '&blink=' + encodeURIComponent(options['blink'] || 'false') +
+    '&animation=' + encodeURIComponent(options['animation'] || 'auto');
 
 
   //console.log('showing configuration at uri: ' + uri);
@@ -234,11 +449,7 @@ Pebble.addEventListener('webviewclosed', function(e) {
 });
 
 Pebble.addEventListener("ready", function(e) {
-  //console.log("connect!" + e.ready);
-  updateWeather();
-  setInterval(function() {
-    //console.log("timer fired");
-    updateWeather();
-  }, 1800000); // 30 minutes
+  // the watch asks for weather when it wants it (see src/link.c), so there is no timer here
   console.log(e.type);
+  requestLedger();
 });
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include <pebble.h>
+#include "ledger.h"
+
+// after FORECAST_PERSIST_KEY (0x11) in forecast.c
+#define LEDGER_PERSIST_KEY 0x12
+#define LEDGER_CACHE_VERSION 1
+
+// dictionary overhead of an AppMessage: a count byte, and key, type and length per tuple
+#define LEDGER_DICT_HEADER 1
+#define LEDGER_TUPLE_HEADER 7
+
+typedef struct {
+  uint8_t  battery;
+  uint8_t  messages;
+  uint8_t  vibes;
+  uint8_t  disconnects;
+  uint16_t frames;
+  uint16_t message_bytes;
+} LedgerHour;
+
+typedef struct {
+  uint8_t    version;   // LEDGER_CACHE_VERSION
+  uint8_t    head;      // slot of the current hour
+  uint8_t    count;     // hours recorded, the current one included
+  uint32_t   start;     // start of the current hour
+  LedgerHour hours[LEDGER_HOURS];
+} LedgerRing;
+
+static LedgerRing s_ring;
+static uint8_t s_battery = LEDGER_BATTERY_UNKNOWN;
+static bool s_connected = true;
+
+#define LEDGER_ADD(field, amount, max) \
+  (field) = (field) > (max) - (amount) ? (max) : (field) + (amount)
+
+static uint8_t battery_byte(BatteryChargeState battery) {
+  return battery.charge_percent | (battery.is_charging ? LEDGER_CHARGING : 0);
+}
+
+// starts a bucket for every hour since the current one; hours the face missed keep no battery
+static void ledger_advance(time_t now) {
+  time_t hour = now - now % LEDGER_HOUR_S;
+  if (s_ring.count > 0 && hour <= (time_t) s_ring.start) return;
+
+  uint32_t gap = s_ring.count == 0 ? 1 : (hour - s_ring.start) / LEDGER_HOUR_S;
+  if (gap > LEDGER_HOURS) gap = LEDGER_HOURS;
+  for (uint32_t i = 0; i < gap; i++) {
+    s_ring.head = (s_ring.head + 1) % LEDGER_HOURS;
+    if (s_ring.count < LEDGER_HOURS) s_ring.count++;
+    s_ring.hours[s_ring.head] = (LedgerHour) { .battery = LEDGER_BATTERY_UNKNOWN };
+  }
+  s_ring.hours[s_ring.head].battery = s_battery;
+  s_ring.start = hour;
+}
+
+void ledger_open(BatteryChargeState battery, bool connected) {
+  if (persist_read_data(LEDGER_PERSIST_KEY, &s_ring, sizeof(s_ring)) != sizeof(s_ring) ||
+      s_ring.version != LEDGER_CACHE_VERSION || s_ring.head >= LEDGER_HOURS || s_ring.count > LEDGER_HOURS) {
+    memset(&s_ring, 0, sizeof(s_ring));
+    s_ring.version = LEDGER_CACHE_VERSION;
+  }
+  s_battery = battery_byte(battery);
+  s_connected = connected;
+  ledger_advance(time(NULL));
+}
+
+void ledger_close(void) {
+  persist_write_data(LEDGER_PERSIST_KEY, &s_ring, sizeof(s_ring));
+}
+
+void ledger_hour(time_t now) {
+  time_t start = s_ring.start;
+  ledger_advance(now);
+  if ((time_t) s_ring.start != start) ledger_close();
+}
+
+void ledger_frame(void) {
+  LEDGER_ADD(s_ring.hours[s_ring.head].frames, 1, UINT16_MAX);
+}
+
+void ledger_tuple(bool first, uint16_t length) {
+  LedgerHour *hour = &s_ring.hours[s_ring.head];
+  if (first) LEDGER_ADD(hour->messages, 1, UINT8_MAX);
+  LEDGER_ADD(hour->message_bytes, (first ? LEDGER_DICT_HEADER : 0) + LEDGER_TUPLE_HEADER + length, UINT16_MAX);
+}
+
+void ledger_vibe(void) {
+  LEDGER_ADD(s_ring.hours[s_ring.head].vibes, 1, UINT8_MAX);
+}
+
+void ledger_set_battery(BatteryChargeState battery) {
+  s_battery = battery_byte(battery);
+}
+
+void ledger_set_connected(bool connected) {
+  if (s_connected && !connected) LEDGER_ADD(s_ring.hours[s_ring.head].disconnects, 1, UINT8_MAX);
+  s_connected = connected;
+}
+
+uint16_t ledger_pack(uint8_t data[LEDGER_PAYLOAD_MAX]) {
+  uint32_t oldest = s_ring.count == 0 ? s_ring.start : s_ring.start - (s_ring.count - 1) * LEDGER_HOUR_S;
+  data[0] = LEDGER_PROTOCOL_VERSION;
+  data[1] = oldest & 0xFF;
+  data[2] = (oldest >> 8) & 0xFF;
+  data[3] = (oldest >> 16) & 0xFF;
+  data[4] = oldest >> 24;
+  data[5] = s_ring.count;
+  for (int i = 0; i < s_ring.count; i++) {
+    const LedgerHour *hour = &s_ring.hours[(s_ring.head + LEDGER_HOURS - (s_ring.count - 1) + i) % LEDGER_HOURS];
+    uint8_t *entry = &data[LEDGER_HEADER_SIZE + i * LEDGER_ENTRY_SIZE];
+    entry[0] = hour->battery;
+    entry[1] = hour->frames & 0xFF;
+    entry[2] = hour->frames >> 8;
+    entry[3] = hour->messages;
+    entry[4] = hour->message_bytes & 0xFF;
+    entry[5] = hour->message_bytes >> 8;
+    entry[6] = hour->vibes;
+    entry[7] = hour->disconnects;
+  }
+  return LEDGER_HEADER_SIZE + s_ring.count * LEDGER_ENTRY_SIZE;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <pebble.h>
+
+
+// Energy ledger: what the face did in each of the last LEDGER_HOURS hours, so the phone can set
+// battery drain against it. Every hour records the digit animation frames run, the AppMessages
+// taken in and their bytes, the vibrations fired, the Bluetooth disconnects and the battery at
+// the start of the hour. The hours are kept in a ring in persist storage, written when an hour
+// is over and when the app exits; the counting in between only touches memory.
+//
+// The phone asks for it under REQUEST_LEDGER_KEY and gets every hour in one LEDGER_KEY message:
+//   u8 version, u32 start (time of the oldest hour, little endian), u8 count,
+//   count x { u8 battery, u16 frames, u8 messages, u16 message bytes, u8 vibes, u8 disconnects }
+// oldest hour first, the current one last. Counters stop at their maximum.
+#define LEDGER_PROTOCOL_VERSION 1
+#define LEDGER_HOURS 24
+#define LEDGER_HOUR_S (60 * 60)
+#define LEDGER_HEADER_SIZE 6
+#define LEDGER_ENTRY_SIZE 8
+#define LEDGER_PAYLOAD_MAX (LEDGER_HEADER_SIZE + LEDGER_HOURS * LEDGER_ENTRY_SIZE)
+
+// battery byte: the percentage, LEDGER_CHARGING added while charging
+#define LEDGER_CHARGING 0x80
+#define LEDGER_BATTERY_UNKNOWN 0xFF   // the face was not running when the hour started
+
+// restores the ring and moves it on to the current hour
+void ledger_open(BatteryChargeState battery, bool connected);
+
+// saves the ring
+void ledger_close(void);
+
+// hour tick: starts the next bucket, saving the one that is over
+void ledger_hour(time_t now);
+
+void ledger_frame(void);
+
+// one tuple of an inbound AppMessage; first is set on the first tuple of each message
+void ledger_tuple(bool first, uint16_t length);
+
+void ledger_vibe(void);
+
+void ledger_set_battery(BatteryChargeState battery);
+
+// counts the disconnects
+void ledger_set_connected(bool connected);
+
+// the ring as the LEDGER_KEY payload; returns its size
+uint16_t ledger_pack(uint8_t data[LEDGER_PAYLOAD_MAX]);
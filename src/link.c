@@ -0,0 +1,163 @@
+#include <pebble.h>
+#include "link.h"
+#include "weather.h"
+#include "forecast.h"
+#include "ledger.h"
+
+#define LINK_RETRY_FIRST_MS 2000
+#define LINK_RETRY_MAX_MS 60000
+// 2 + 4 + 8 + 16 + 32 + 60 s: after two minutes the next scheduled refresh takes over
+#define LINK_RETRY_ATTEMPTS 6
+
+// the phone used to refresh every 30 minutes on its own
+#define LINK_REFRESH_S (30 * 60)
+// with a forecast covering the next few hours a refresh only needs to correct it now and then
+#define LINK_FORECAST_REFRESH_S (6 * 60 * 60)
+#define LINK_FORECAST_AHEAD_S (3 * 60 * 60)
+// battery levels that stretch the interval: x2 at or below LOW, x4 at or below CRITICAL
+#define LINK_BATTERY_LOW 20
+#define LINK_BATTERY_CRITICAL 10
+// a reconnect asks at once unless the data is younger than this, so a flapping link stays quiet
+#define LINK_RECONNECT_MIN_AGE_S (5 * 60)
+
+static LinkStats s_stats;
+static AppTimer *s_retry_timer = NULL;
+static uint32_t s_retry_ms = LINK_RETRY_FIRST_MS;
+static uint8_t s_retry_attempts = 0;
+
+static time_t s_last_update = 0;   // last update or, if none came back, last scheduled request
+static bool s_connected = true;
+static uint8_t s_refresh_scale = 1;
+static time_t s_forecast_until = 0;
+static bool s_ledger_pending = false; // asked for, not sent yet
+
+static void link_retry(void *data) {
+  s_retry_timer = NULL;
+  link_request_weather();
+}
+
+static void link_schedule_retry(void) {
+  if (s_retry_timer || !s_connected) return; // one failure per attempt is enough
+
+  if (s_retry_attempts >= LINK_RETRY_ATTEMPTS) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "link: giving up after %d retries", s_retry_attempts);
+    return;
+  }
+  s_retry_attempts++;
+  s_retry_timer = app_timer_register(s_retry_ms, link_retry, NULL);
+  s_retry_ms = s_retry_ms * 2 > LINK_RETRY_MAX_MS ? LINK_RETRY_MAX_MS : s_retry_ms * 2;
+}
+
+static void link_reset_retry(void) {
+  if (s_retry_timer) {
+    app_timer_cancel(s_retry_timer);
+    s_retry_timer = NULL;
+  }
+  s_retry_ms = LINK_RETRY_FIRST_MS;
+  s_retry_attempts = 0;
+}
+
+// asks if the data is at least min_age old; an unanswered request waits a full interval too
+static void link_refresh_if_older(time_t now, time_t min_age) {
+  if (!s_connected || (s_last_update != 0 && now - s_last_update < min_age)) return;
+
+  s_last_update = now;
+  link_request_weather();
+}
+
+void link_open(void) {
+  // weather and forecast plus the four settings, the most the phone puts in one message;
+  // PebbleKit JS sends every number as an int32
+  uint32_t inbox = dict_calc_buffer_size(6, WEATHER_PAYLOAD_SIZE, FORECAST_PAYLOAD_MAX, sizeof(int32_t),
+                                         sizeof(int32_t), sizeof(int32_t), sizeof(int32_t));
+  // the biggest thing the watch sends is the ledger
+  uint32_t outbox = dict_calc_buffer_size(1, LEDGER_PAYLOAD_MAX);
+  if (inbox > app_message_inbox_size_maximum()) inbox = app_message_inbox_size_maximum();
+  if (outbox > app_message_outbox_size_maximum()) outbox = app_message_outbox_size_maximum();
+  app_message_open(inbox, outbox);
+}
+
+void link_close(void) {
+  link_reset_retry();
+  APP_LOG(APP_LOG_LEVEL_INFO, "link: %d received, %d failed, %d requests",
+          s_stats.received, s_stats.failed, s_stats.requests);
+}
+
+void link_request_weather(void) {
+  DictionaryIterator *iter;
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+    link_schedule_retry();
+    return;
+  }
+  dict_write_uint8(iter, REQUEST_WEATHER_KEY, 1);
+  if (app_message_outbox_send() != APP_MSG_OK) {
+    link_schedule_retry();
+    return;
+  }
+  s_stats.requests++;
+}
+
+void link_send_ledger(void) {
+  s_ledger_pending = true;
+  DictionaryIterator *iter;
+  if (!s_connected || app_message_outbox_begin(&iter) != APP_MSG_OK) return;
+
+  uint8_t payload[LEDGER_PAYLOAD_MAX];
+  dict_write_data(iter, LEDGER_KEY, payload, ledger_pack(payload));
+  if (app_message_outbox_send() == APP_MSG_OK) s_ledger_pending = false;
+}
+
+void link_received(void) {
+  s_stats.received++;
+  s_last_update = time(NULL);
+  link_reset_retry();
+}
+
+void link_schedule_start(time_t last_update) {
+  s_last_update = last_update;
+  s_connected = bluetooth_connection_service_peek();
+  link_set_battery(battery_state_service_peek());
+  link_tick(time(NULL));
+}
+
+void link_tick(time_t now) {
+  if (s_ledger_pending) link_send_ledger();
+  time_t interval = s_forecast_until - now >= LINK_FORECAST_AHEAD_S ? LINK_FORECAST_REFRESH_S : LINK_REFRESH_S;
+  link_refresh_if_older(now, interval * s_refresh_scale);
+}
+
+void link_set_connected(bool connected) {
+  if (connected == s_connected) return;
+  s_connected = connected;
+
+  if (connected) {
+    link_refresh_if_older(time(NULL), LINK_RECONNECT_MIN_AGE_S);
+  } else {
+    // sends would only fail; the reconnect asks again
+    link_reset_retry();
+  }
+}
+
+void link_set_forecast(time_t until) {
+  s_forecast_until = until;
+}
+
+void link_set_battery(BatteryChargeState charge_state) {
+  if (charge_state.is_charging || charge_state.charge_percent > LINK_BATTERY_LOW) {
+    s_refresh_scale = 1;
+  } else if (charge_state.charge_percent > LINK_BATTERY_CRITICAL) {
+    s_refresh_scale = 2;
+  } else {
+    s_refresh_scale = 4;
+  }
+}
+
+void link_sync_error(DictionaryResult dict_error, AppMessageResult app_message_error, void *context) {
+  s_stats.failed++;
+  APP_LOG(APP_LOG_LEVEL_WARNING, "link: sync error, dict %d, app message %d", dict_error, app_message_error);
+  link_schedule_retry();
+}
+
+const LinkStats* link_stats(void) {
+  return &s_stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <pebble.h>
+
+
+// The watch's side of the phone link: AppMessage buffers sized for the weather schema, the
+// AppSync error path and weather requests. A failed or dropped update is followed by a request
+// for a resend, backing off from LINK_RETRY_FIRST_MS up to LINK_RETRY_MAX_MS between attempts,
+// so a lost push is repaired within seconds rather than at the phone's next refresh.
+//
+// The watch also owns the refresh schedule: the phone only fetches weather when asked. A request
+// goes out on the minute tick once the last update is LINK_REFRESH_MS old, that interval
+// doubling on a low battery and doubling again when it is nearly empty. Nothing is asked for
+// while Bluetooth is down, and reconnecting asks straight away unless the data is recent.
+// While the watch holds a forecast reaching LINK_FORECAST_AHEAD_S ahead, the face moves on by
+// itself and the interval stretches to LINK_FORECAST_REFRESH_S.
+
+typedef struct {
+  uint16_t received;  // weather updates taken in
+  uint16_t failed;    // AppSync errors: dropped inbox messages and failed sends
+  uint16_t requests;  // weather requests sent, scheduled and retries
+} LinkStats;
+
+// opens AppMessage with an inbox just big enough for one full update
+void link_open(void);
+
+// cancels a pending retry and logs the session's counters
+void link_close(void);
+
+// asks the phone for fresh weather now; retries with backoff if it cannot be sent
+void link_request_weather(void);
+
+// sends the energy ledger (ledger.h) the phone asked for; while the outbox is busy or Bluetooth
+// is down it stays pending and goes out on a later minute tick
+void link_send_ledger(void);
+
+// a weather update arrived: the link is healthy again and the refresh clock restarts
+void link_received(void);
+
+// starts the schedule from the time of the last update on record, 0 for none; asks right
+// away when that is already due
+void link_schedule_start(time_t last_update);
+
+// minute tick: asks for a refresh when one is due
+void link_tick(time_t now);
+
+void link_set_connected(bool connected);
+
+// end of the forecast on the watch, 0 for none
+void link_set_forecast(time_t until);
+
+void link_set_battery(BatteryChargeState charge_state);
+
+// AppSyncErrorCallback
+void link_sync_error(DictionaryResult dict_error, AppMessageResult app_message_error, void *context);
+
+const LinkStats* link_stats(void);
@@ -1,6 +1,15 @@
 #include <pebble.h>
 #include "main.h"
 #include "slide_layer.h"
+#include "atlas.h"
+#include "trace.h"
+#include "weather.h"
+#include "link.h"
+#include "forecast.h"
+#include "temp_text.h"
+#include "anim_policy.h"
+#include "perf.h"
+#include "ledger.h"
 	
 Window *window;
 static Layer *window_layer;
@@ -25,67 +34,140 @@ static const uint32_t WEATHER_ICONS[] = {
 
 static int invert;
 static int bluetoothvibe;
+static bool blink;
 //static int hourlyvibe;
 
 static bool appStarted = false;
 
-enum WeatherKey {
-  WEATHER_ICON_KEY = 0x0,
-  WEATHER_TEMPERATURE_KEY = 0x1,
-  INVERT_COLOR_KEY = 0x2,	  
-  BLUETOOTHVIBE_KEY = 0x3,
-//  HOURLYVIBE_KEY = 0x4,
-  CITY_KEY = 0x5
-};
+// Last weather the phone sent, kept in persist storage so a launch can show it straight away
+// instead of N/A until the phone answers.
+#define WEATHER_CACHE_KEY 0x10
+#define WEATHER_CACHE_VERSION 2
+// the phone refreshes every 30 minutes; older than two refreshes and the panel is marked stale
+#define WEATHER_STALE_SECONDS (60 * 60)
+
+typedef struct {
+  uint8_t       version;
+  WeatherReport report;
+  uint32_t      updated;    // time() of the push it came from
+} WeatherCache;
+
+static WeatherCache s_weather_cache;
 
 SlideLayer *slide_layer[4];
 
-BitmapLayer *layer_conn_img;
 GBitmap *img_bt_connect;
 GBitmap *img_bt_disconnect;
 
-BitmapLayer *icon_layer;
 GBitmap *icon_bitmap = NULL;
 
-TextLayer *temp_layer;
-TextLayer *city_layer;
-TextLayer *layer_date_text;
-Layer* weather_holder;
+// The lower panel is a single layer that draws everything in it in one pass, each element into
+// its own rect: background, weather icon, temperature, condition, date, battery and Bluetooth.
+// Inversion happens in the same pass, with the bitmaps drawn inverted and the text in white.
+static Layer *s_panel;
+#define PANEL_FRAME GRect(6, 77, 132, 77)
+static const GRect PANEL_BACKGROUND = {{0, 4}, {132, 72}};
+static const GRect PANEL_ICON       = {{1, 4}, {128, 68}};
+static const GRect PANEL_TEMP       = {{30, 3}, {100, 40}};
+static const GRect PANEL_CITY       = {{3, 52}, {90, 24}};
+static const GRect PANEL_DATE       = {{3, 0}, {45, 120}};
+static const GRect PANEL_BT         = {{115, 37}, {11, 18}};
+static const GRect PANEL_BATTERY    = {{91, 59}, {35, 11}};
+
+// the parts of the background a full-size icon leaves showing: left, right and bottom edges
+static const GRect PANEL_BACKGROUND_EDGES[] = {
+  {{0, 0}, {1, 72}},
+  {{129, 0}, {3, 72}},
+  {{1, 68}, {128, 4}}
+};
+static GBitmap *s_background_edges[ARRAY_LENGTH(PANEL_BACKGROUND_EDGES)];
+
+static GFont s_date_font;
+static GFont s_city_font;
 
 static GBitmap *s_time_format_bitmap;
 static BitmapLayer *s_time_format_layer;
 
-static GFont *steelfish;
+// Seconds mode: a colon between the hours and the minutes, shown on even seconds. The per-second
+// tick only hides or shows this layer, so a second costs one small dirty rect.
+static Layer *s_separator;
+#define SEPARATOR_FRAME GRect(69, 28, 6, 30)
+static const GRect SEPARATOR_DOTS[] = {
+  {{0, 0}, {6, 6}},
+  {{0, 24}, {6, 6}}
+};
+
+static bool separator_on(const struct tm *tick_time) {
+  return blink && tick_time->tm_sec % 2 == 0;
+}
+
+static void tick_subscribe(void);
 
 int cur_day = -1;
 
-BitmapLayer *layer_batt_img;
-GBitmap *img_battery_100;
-GBitmap *img_battery_90;
-GBitmap *img_battery_80;
-GBitmap *img_battery_70;
-GBitmap *img_battery_60;
-GBitmap *img_battery_50;
-GBitmap *img_battery_40;
-GBitmap *img_battery_30;
-GBitmap *img_battery_20;
-GBitmap *img_battery_10;
-GBitmap *img_battery_charge;
+GBitmap *img_battery; // one view, moved between the sheet's members as the level changes
 int charge_percent = 0;
 
-InverterLayer *inverter_layer = NULL;
+// battery sheet member per 10% bucket: 0-10%, 11-20%, ... 91-100%
+static const uint8_t BATTERY_BUCKETS[] = {
+  ATLAS_BATTERY_000_010, ATLAS_BATTERY_010_020, ATLAS_BATTERY_020_030, ATLAS_BATTERY_030_040,
+  ATLAS_BATTERY_040_050, ATLAS_BATTERY_050_060, ATLAS_BATTERY_060_070, ATLAS_BATTERY_070_080,
+  ATLAS_BATTERY_080_090, ATLAS_BATTERY_090_100
+};
 
 static AppSync sync;
-static uint8_t sync_buffer[128];
+static uint8_t sync_buffer[156]; // header, packed weather, a full forecast, four settings and the
+                                 // ledger request, all as the phone's int32s: 155 bytes
 
 GBitmap *background_image;
-static BitmapLayer *background_image_layer;
+
+// What the face should show. Handlers only write s_view; view_commit() compares it with
+// s_shown, what the layers currently display, and touches just the layers whose fields differ.
+typedef struct {
+  bool    valid;            // s_shown only: false until the first commit after window_load
+  bool    widgets_valid;    // s_shown only: battery, BT and weather fields are on screen
+  uint8_t digits[4];        // HHMM, 0xFF = not known yet
+  bool    hour_tens_hidden;
+  bool    ampm_hidden;
+  bool    pm;
+  bool    separator;        // seconds mode, on even seconds
+  uint8_t battery;          // ATLAS_BATTERY_* member
+  bool    bt_connected;
+  uint8_t weather_icon;     // index into WEATHER_ICONS
+  bool    inverted;
+  char    date[17];
+  char    city[32];
+  char    temp[8];
+  bool    weather_stale;    // temp shows cached data older than WEATHER_STALE_SECONDS and no
+                            // forecast covers the hour
+} ViewState;
+
+static ViewState s_view;
+static ViewState s_shown;
+static bool s_view_ready = false; // layers exist
+static char s_temp_text[9];       // s_shown.temp with the staleness marker
+
+// Startup runs in two phases so the face shows up as soon as it can. window_load loads only
+// what the first frame needs: digits, background, AM/PM and date. The first draw then
+// schedules widgets_load() for the battery and Bluetooth sheets, the temperature glyphs and icon.
+static bool s_widgets_ready = false;
+static bool s_first_frame_drawn = false;
+static AppTimer *s_widgets_timer = NULL;
+static time_t s_launch_s;
+static uint16_t s_launch_ms;
+
+// Handlers that come in bursts (an AppMessage's tuples, battery and Bluetooth events) post their
+// changes with view_post(), and a 0 ms timer commits them all on the next event-loop turn. Ticks
+// commit straight away: a tick is one event already, and the commit takes any posted changes along.
+static AppTimer *s_commit_timer = NULL;
+static bool s_message_posted = false; // an AppMessage's tuples are in s_view, not committed yet
 
 
 static void set_container_image(GBitmap **bmp_image, BitmapLayer *bmp_layer, const int resource_id, GPoint origin) {
   GBitmap *old_image = *bmp_image;
 
   *bmp_image = gbitmap_create_with_resource(resource_id);
+  perf_resource_load();
 #ifdef PBL_PLATFORM_BASALT
   GRect bitmap_bounds = gbitmap_get_bounds((*bmp_image));
 #else
@@ -101,20 +183,129 @@ static void set_container_image(GBitmap **bmp_image, BitmapLayer *bmp_layer, con
 }
 
 
-void set_invert_color(bool invert) {
-  if (invert && inverter_layer == NULL) {
-    // Add inverter layer
-    Layer *window_layer = window_get_root_layer(window);
+static void view_commit(void) {
+  if (s_commit_timer) {
+    app_timer_cancel(s_commit_timer);
+    s_commit_timer = NULL;
+  }
+  s_message_posted = false;
+  if (!s_view_ready) return;
+  
+  bool all = !s_shown.valid;
+  
+  for (int i = 0; i < 4; i++) {
+    if (all || s_view.digits[i] != s_shown.digits[i]) {
+      slide_layer_animate_to(slide_layer[i], s_view.digits[i]);
+    }
+  }
+  
+  if (all || s_view.hour_tens_hidden != s_shown.hour_tens_hidden) {
+    layer_set_hidden(slide_layer_get_layer(slide_layer[0]), s_view.hour_tens_hidden);
+  }
+  
+  if (s_time_format_layer) {
+    if (all || s_view.ampm_hidden != s_shown.ampm_hidden) {
+      layer_set_hidden(bitmap_layer_get_layer(s_time_format_layer), s_view.ampm_hidden);
+    }
+    if (all || s_view.pm != s_shown.pm) {
+      set_container_image(&s_time_format_bitmap, s_time_format_layer,
+                          s_view.pm ? RESOURCE_ID_IMAGE_PM_MODE : RESOURCE_ID_IMAGE_AM_MODE, GPoint(6, 54));
+    }
+  }
+  
+  if (all || s_view.separator != s_shown.separator) {
+    layer_set_hidden(s_separator, !s_view.separator);
+  }
+  
+  // the panel draws from s_shown, so it only needs marking dirty when one of its fields changed
+  bool panel_dirty = all || s_view.inverted != s_shown.inverted || strcmp(s_view.date, s_shown.date) != 0;
+  
+  if (s_widgets_ready) {
+    bool widgets_all = all || !s_shown.widgets_valid;
+    
+    if (widgets_all || s_view.battery != s_shown.battery) {
+      atlas_set_member(img_battery, ATLAS_BATTERY, s_view.battery);
+      panel_dirty = true;
+    }
+    
+    if (widgets_all || s_view.weather_icon != s_shown.weather_icon) {
+      if (icon_bitmap) {
+        gbitmap_destroy(icon_bitmap);
+      }
+      icon_bitmap = gbitmap_create_with_resource(WEATHER_ICONS[s_view.weather_icon]);
+      perf_resource_load();
+      panel_dirty = true;
+    }
+    
+    if (widgets_all || strcmp(s_view.temp, s_shown.temp) != 0 || s_view.weather_stale != s_shown.weather_stale) {
+      snprintf(s_temp_text, sizeof(s_temp_text), "%s%s", s_view.weather_stale ? "~" : "", s_view.temp);
+      panel_dirty = true;
+    }
+    
+    panel_dirty = panel_dirty || widgets_all || s_view.bt_connected != s_shown.bt_connected ||
+                  strcmp(s_view.city, s_shown.city) != 0;
+  }
+  
+  if (panel_dirty) {
+    layer_mark_dirty(s_panel);
+  }
+  
+  s_shown = s_view;
+  s_shown.valid = true;
+  s_shown.widgets_valid = s_widgets_ready;
+}
+
+static void view_commit_posted(void *data) {
+  s_commit_timer = NULL;
+  view_commit();
+}
+
+static void view_post(void) {
+  if (!s_commit_timer) {
+    s_commit_timer = app_timer_register(0, view_commit_posted, NULL);
+  }
+}
+
+// fresh weather arrived: drop the stale marker and keep it for the next launch
+static void weather_cache_save(const WeatherReport *report) {
+  s_view.weather_stale = false;
+  s_weather_cache.version = WEATHER_CACHE_VERSION;
+  s_weather_cache.report = *report;
+  s_weather_cache.updated = time(NULL);
+  persist_write_data(WEATHER_CACHE_KEY, &s_weather_cache, sizeof(s_weather_cache));
+}
+
+// false when nothing usable is stored; s_weather_cache is zeroed then
+static bool weather_cache_load(void) {
+  if (persist_read_data(WEATHER_CACHE_KEY, &s_weather_cache, sizeof(s_weather_cache)) != sizeof(s_weather_cache) ||
+      s_weather_cache.version != WEATHER_CACHE_VERSION) {
+    memset(&s_weather_cache, 0, sizeof(s_weather_cache));
+    return false;
+  }
+  return true;
+}
+
+static bool weather_cache_stale(time_t now) {
+  return s_weather_cache.updated != 0 && now - (time_t) s_weather_cache.updated > WEATHER_STALE_SECONDS &&
+         forecast_until() <= now;
+}
+
+// the text is rendered here rather than sent: the condition goes in the city line
+static void weather_show(const WeatherReport *report) {
+  s_view.weather_icon = report->icon;
+  weather_format_temperature(report, s_view.temp, sizeof(s_view.temp));
+  strncpy(s_view.city, weather_condition_text(report->condition), sizeof(s_view.city) - 1);
+}
 
-    inverter_layer = inverter_layer_create(GRect(7, 82, 128, 72));
-    layer_add_child(window_layer, inverter_layer_get_layer(inverter_layer));
-  } else if (!invert && inverter_layer != NULL) {
-    // Remove Inverter layer
-    layer_remove_from_parent(inverter_layer_get_layer(inverter_layer));
-    inverter_layer_destroy(inverter_layer);
-    inverter_layer = NULL;
+// on the hour: once the last report is from an earlier forecast hour, this hour's forecast
+// replaces it
+static void weather_follow_forecast(time_t now) {
+  WeatherReport report;
+  time_t hour_start;
+  if (forecast_at(now, &report, &hour_start) && (time_t) s_weather_cache.updated < hour_start &&
+      report.icon < ARRAY_LENGTH(WEATHER_ICONS)) {
+    weather_show(&report);
   }
-  // No action required
 }
 
 static void sync_tuple_changed_callback(const uint32_t key,
@@ -122,35 +313,68 @@ static void sync_tuple_changed_callback(const uint32_t key,
                                         const Tuple* old_tuple,
                                         void* context) {	
 
-  // App Sync keeps new_tuple in sync_buffer, so we may use it directly
+  perf_enter(PERF_SYNC);
+  // a message's tuples come in one after another, and the commit after them ends the message;
+  // the initial values before appStarted come from persist storage, which the trace snapshots
+  if (appStarted) {
+    trace_tuple(new_tuple);
+    ledger_tuple(!s_message_posted, new_tuple->length);
+    s_message_posted = true;
+  }
+
   switch (key) {
-    case WEATHER_ICON_KEY:
-      if (icon_bitmap) {
-        gbitmap_destroy(icon_bitmap);
+    case WEATHER_KEY: {
+      // a zeroed payload (no cache yet) is skipped
+      WeatherReport report;
+      if (weather_unpack(new_tuple->value->data, new_tuple->length, &report) &&
+          report.icon < ARRAY_LENGTH(WEATHER_ICONS)) {
+        weather_show(&report);
+        if (appStarted) {
+          weather_cache_save(&report);
+          link_received();
+        }
       }
-      icon_bitmap = gbitmap_create_with_resource(
-          WEATHER_ICONS[new_tuple->value->uint8]);
-      bitmap_layer_set_bitmap(icon_layer, icon_bitmap);
-    break;
-	  
-	case CITY_KEY:
-      text_layer_set_text(city_layer, new_tuple->value->cstring);
-    break;
+      break;
+    }
 
-    case WEATHER_TEMPERATURE_KEY:
-      text_layer_set_text(temp_layer, new_tuple->value->cstring);
+    // the initial one-byte placeholder is not a forecast; the stored one came from persist
+    case FORECAST_KEY:
+      if (appStarted && forecast_receive(new_tuple->value->data, new_tuple->length)) {
+        link_set_forecast(forecast_until());
+      }
       break;
 
+	// settings only arrive when they change; the initial values came from persist already
 	case INVERT_COLOR_KEY:
       invert = new_tuple->value->uint8 != 0;
-	  persist_write_bool(INVERT_COLOR_KEY, invert);
-      set_invert_color(invert);
+	  if (appStarted) persist_write_bool(INVERT_COLOR_KEY, invert);
+      s_view.inverted = invert;
       break;
 	  
     case BLUETOOTHVIBE_KEY:
       bluetoothvibe = new_tuple->value->uint8 != 0;
-	  persist_write_bool(BLUETOOTHVIBE_KEY, bluetoothvibe);
+	  if (appStarted) persist_write_bool(BLUETOOTHVIBE_KEY, bluetoothvibe);
       break;      
+
+    case ANIMATION_KEY:
+      if (appStarted) persist_write_int(ANIMATION_KEY, new_tuple->value->uint8);
+      anim_policy_set_setting(new_tuple->value->uint8);
+      break;
+
+    case BLINK_KEY:
+      blink = new_tuple->value->uint8 != 0;
+      if (appStarted) {
+        persist_write_bool(BLINK_KEY, blink);
+        tick_subscribe();
+        time_t now = time(NULL);
+        s_view.separator = separator_on(localtime(&now));
+      }
+      break;
+
+    // the placeholder in the initial values is 0
+    case REQUEST_LEDGER_KEY:
+      if (appStarted && new_tuple->value->uint32 != 0) link_send_ledger();
+      break;
 	  /*
     case HOURLYVIBE_KEY:
       hourlyvibe = new_tuple->value->uint8 != 0;
@@ -158,6 +382,9 @@ static void sync_tuple_changed_callback(const uint32_t key,
       break;
 */
   }
+  
+  view_post();
+  perf_leave(PERF_SYNC);
 }
 
 unsigned short get_display_hour(unsigned short hour) {
@@ -173,8 +400,9 @@ unsigned short get_display_hour(unsigned short hour) {
 
 void tick_handler(struct tm *tick_time, TimeUnits units_changed) {	
 	
-	 static char date_text[] = "xxx xxx 00xx xxx";
-
+	trace_tick();
+	perf_enter(PERF_TICK);
+	
 	int new_cur_day = tick_time->tm_year*1000 + tick_time->tm_yday;
     if (new_cur_day != cur_day) {
         cur_day = new_cur_day;
@@ -184,116 +412,237 @@ void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
     case 1 :
     case 21 :
     case 31 :
-      strftime(date_text, sizeof(date_text), "%a, %est %b", tick_time);
+      strftime(s_view.date, sizeof(s_view.date), "%a, %est %b", tick_time);
       break;
     case 2 :
     case 22 :
-      strftime(date_text, sizeof(date_text), "%a, %end %b", tick_time);
+      strftime(s_view.date, sizeof(s_view.date), "%a, %end %b", tick_time);
       break;
     case 3 :
     case 23 :
-      strftime(date_text, sizeof(date_text), "%a, %erd %b", tick_time);
+      strftime(s_view.date, sizeof(s_view.date), "%a, %erd %b", tick_time);
       break;
     default :
-      strftime(date_text, sizeof(date_text), "%a, %eth %b", tick_time);
+      strftime(s_view.date, sizeof(s_view.date), "%a, %eth %b", tick_time);
       break;
   }
-    text_layer_set_text(layer_date_text, date_text);	
 	
     }; 
  
 unsigned short display_hour = get_display_hour(tick_time->tm_hour);
 
-   slide_layer_animate_to(slide_layer[0], display_hour / 10);
+   s_view.digits[0] = display_hour / 10;
+   s_view.digits[1] = display_hour % 10;
+   s_view.digits[2] = tick_time->tm_min / 10;
+   s_view.digits[3] = tick_time->tm_min % 10;
+   s_view.separator = separator_on(tick_time);
 
-  if (!clock_is_24h_style()) {
-    if (display_hour/10 >= 1) {
-      layer_set_hidden(slide_layer_get_layer(slide_layer[0]), false);
+ if (!clock_is_24h_style()) {
+    s_view.hour_tens_hidden = display_hour / 10 == 0;
+    s_view.ampm_hidden = display_hour / 10 != 0;
+    s_view.pm = tick_time->tm_hour >= 12;
+ } 
 
-    }  else {
-      layer_set_hidden(slide_layer_get_layer(slide_layer[0]), true);
+ time_t now = time(NULL);
+ if (units_changed & HOUR_UNIT) {
+   ledger_hour(now);
+   weather_follow_forecast(now);
+ }
 
-    }
-  }
+ // the phone may have gone quiet since the last push; ask for one when it is due
+ s_view.weather_stale = weather_cache_stale(now);
+ link_tick(now);
 
-    slide_layer_animate_to(slide_layer[1], display_hour % 10);
-	
-    slide_layer_animate_to(slide_layer[2], tick_time->tm_min / 10);
-    slide_layer_animate_to(slide_layer[3], tick_time->tm_min % 10);
+ view_commit();
+ perf_leave(PERF_TICK);
+ perf_minute();
+}    
 
- if (!clock_is_24h_style()) {		
-    if (display_hour / 10 == 0) {	
-    	layer_set_hidden(bitmap_layer_get_layer(s_time_format_layer), false);
+// seconds mode: the minute's first second runs the whole minute tick, every other one only
+// blinks the separator
+static void second_handler(struct tm *tick_time, TimeUnits units_changed) {
+  if (units_changed & MINUTE_UNIT) {
+    tick_handler(tick_time, units_changed);
+    return;
+  }
 
-	} else {
-		  layer_set_hidden(bitmap_layer_get_layer(s_time_format_layer), true);
-    }	 
- } 
+  perf_enter(PERF_SECOND);
+  s_view.separator = separator_on(tick_time);
+  view_commit();
+  perf_leave(PERF_SECOND);
+}
 
- if (!clock_is_24h_style()) {
-	 if (tick_time->tm_hour >= 12) {
-       set_container_image(&s_time_format_bitmap, s_time_format_layer, RESOURCE_ID_IMAGE_PM_MODE, GPoint(6, 54));
-	 } else {
-       set_container_image(&s_time_format_bitmap, s_time_format_layer, RESOURCE_ID_IMAGE_AM_MODE, GPoint(6, 54));
-	 }
- }			   
-}    
+static void tick_subscribe(void) {
+  if (blink) {
+    tick_timer_service_subscribe(SECOND_UNIT, second_handler);
+  } else {
+    tick_timer_service_subscribe(MINUTE_UNIT, (TickHandler) tick_handler);
+  }
+}
 
 void handle_battery(BatteryChargeState charge_state) {
 
+    trace_battery(charge_state);
+    perf_enter(PERF_BATTERY);
+
     if (charge_state.is_charging) {
-        bitmap_layer_set_bitmap(layer_batt_img, img_battery_charge);
+        s_view.battery = ATLAS_BATTERY_CHARGING;
     } else {
-        if (charge_state.charge_percent <= 10) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_10);
-        } else if (charge_state.charge_percent <= 20) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_20);
-        } else if (charge_state.charge_percent <= 30) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_30);
-		} else if (charge_state.charge_percent <= 40) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_40);
-		} else if (charge_state.charge_percent <= 50) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_50);
-    	} else if (charge_state.charge_percent <= 60) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_60);	
-        } else if (charge_state.charge_percent <= 70) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_70);
-		} else if (charge_state.charge_percent <= 80) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_80);
-		} else if (charge_state.charge_percent <= 90) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_90);
-		} else if (charge_state.charge_percent <= 100) {
-            bitmap_layer_set_bitmap(layer_batt_img, img_battery_100);			
-			   
+        int bucket = charge_state.charge_percent <= 10 ? 0 : (charge_state.charge_percent - 1) / 10;
+        if (bucket >= (int) ARRAY_LENGTH(BATTERY_BUCKETS)) bucket = ARRAY_LENGTH(BATTERY_BUCKETS) - 1;
+        s_view.battery = BATTERY_BUCKETS[bucket];
+
         if (charge_state.charge_percent < charge_percent) {
             if (charge_state.charge_percent==20){
                 vibes_double_pulse();
+                ledger_vibe();
             } else if(charge_state.charge_percent==10){
                 vibes_long_pulse();
+                ledger_vibe();
             }
         }
     }
-    charge_percent = charge_state.charge_percent;   
-  }
+    // kept while charging too, so unplugging above a threshold and draining to it still warns
+    charge_percent = charge_state.charge_percent;
+  
+  link_set_battery(charge_state);
+  anim_policy_set_battery(charge_state);
+  ledger_set_battery(charge_state);
+  view_post();
+  perf_leave(PERF_BATTERY);
 }
 
 void handle_bluetooth(bool connected) {
-    if (connected) {
-        bitmap_layer_set_bitmap(layer_conn_img, img_bt_connect);
-    } else {
-        bitmap_layer_set_bitmap(layer_conn_img, img_bt_disconnect);
-    }
+    trace_bluetooth(connected);
+
+    s_view.bt_connected = connected;
+    link_set_connected(connected);
+    ledger_set_connected(connected);
 
     if (appStarted && bluetoothvibe) {
       
         vibes_long_pulse();
+        ledger_vibe();
 	}
+	
+    view_post();
 }
 void force_update(void) {
+    // paint the current time now rather than leaving the digits blank until the next minute
+    time_t now = time(NULL);
+    tick_handler(localtime(&now), MINUTE_UNIT | HOUR_UNIT);
     handle_battery(battery_state_service_peek());
     handle_bluetooth(bluetooth_connection_service_peek());
 }
 
+// second phase: everything the first frame could do without
+static void widgets_load(void *data) {
+  s_widgets_timer = NULL;
+
+  atlas_retain(ATLAS_BLUETOOTH);
+  img_bt_connect     = atlas_create_bitmap(ATLAS_BLUETOOTH, ATLAS_BLUETOOTH_ON);
+  img_bt_disconnect  = atlas_create_bitmap(ATLAS_BLUETOOTH, ATLAS_BLUETOOTH_OFF);
+
+  // the battery gauge keeps one view into its sheet; view_commit moves it to the current bucket
+  atlas_retain(ATLAS_BATTERY);
+  img_battery = atlas_create_bitmap(ATLAS_BATTERY, ATLAS_BATTERY_090_100);
+
+  temp_text_load();
+
+  s_widgets_ready = true;
+  view_commit();
+}
+
+static void widgets_unload(void) {
+  s_widgets_ready = false;
+
+  temp_text_unload();
+
+  if (icon_bitmap) {
+    gbitmap_destroy(icon_bitmap);
+    icon_bitmap = NULL;
+  }
+
+  gbitmap_destroy(img_battery);
+  img_battery = NULL;
+  atlas_release(ATLAS_BATTERY);
+
+  gbitmap_destroy(img_bt_connect);
+  gbitmap_destroy(img_bt_disconnect);
+  img_bt_connect = NULL;
+  img_bt_disconnect = NULL;
+  atlas_release(ATLAS_BLUETOOTH);
+}
+
+// runs once, on the first frame: logs the launch latency and starts the second phase
+static void first_frame(void) {
+  s_first_frame_drawn = true;
+
+  time_t now_s;
+  uint16_t now_ms;
+  time_ms(&now_s, &now_ms);
+  APP_LOG(APP_LOG_LEVEL_INFO, "first frame %d ms after launch",
+          (int) ((now_s - s_launch_s) * 1000 + now_ms - s_launch_ms));
+
+  s_widgets_timer = app_timer_register(0, widgets_load, NULL);
+}
+
+static GRect centered_rect(GRect box, const GBitmap *bitmap) {
+#ifdef PBL_PLATFORM_BASALT
+  GSize size = gbitmap_get_bounds(bitmap).size;
+#else
+  GSize size = bitmap->bounds.size;
+#endif
+  return GRect(box.origin.x + (box.size.w - size.w) / 2, box.origin.y + (box.size.h - size.h) / 2, size.w, size.h);
+}
+
+static void panel_update_proc(Layer *layer, GContext *ctx) {
+  if (!s_first_frame_drawn) {
+    first_frame();
+  }
+
+  GCompOp bitmap_op = s_shown.inverted ? GCompOpAssignInverted : GCompOpAssign;
+  graphics_context_set_compositing_mode(ctx, bitmap_op);
+  graphics_context_set_text_color(ctx, s_shown.inverted ? GColorWhite : GColorBlack);
+
+  // the icons cover all of the panel but its edges, so the background only needs drawing there
+  bool widgets = s_shown.widgets_valid;
+  GRect icon_rect = widgets ? centered_rect(PANEL_ICON, icon_bitmap) : GRectZero;
+  if (widgets && grect_equal(&icon_rect, &PANEL_ICON)) {
+    for (size_t i = 0; i < ARRAY_LENGTH(PANEL_BACKGROUND_EDGES); i++) {
+      GRect edge = PANEL_BACKGROUND_EDGES[i];
+      edge.origin.x += PANEL_BACKGROUND.origin.x;
+      edge.origin.y += PANEL_BACKGROUND.origin.y;
+      graphics_draw_bitmap_in_rect(ctx, s_background_edges[i], edge);
+    }
+  } else {
+    graphics_draw_bitmap_in_rect(ctx, background_image, PANEL_BACKGROUND);
+  }
+
+  if (widgets) {
+    graphics_draw_bitmap_in_rect(ctx, icon_bitmap, icon_rect);
+    temp_text_draw(ctx, s_temp_text, PANEL_TEMP, GTextAlignmentRight, s_shown.inverted ? GColorWhite : GColorBlack);
+    graphics_draw_text(ctx, s_shown.city, s_city_font, PANEL_CITY, GTextOverflowModeWordWrap,
+                       GTextAlignmentLeft, NULL);
+  }
+
+  graphics_draw_text(ctx, s_shown.date, s_date_font, PANEL_DATE, GTextOverflowModeWordWrap,
+                     GTextAlignmentLeft, NULL);
+
+  if (widgets) {
+    graphics_context_set_compositing_mode(ctx, bitmap_op);
+    graphics_draw_bitmap_in_rect(ctx, img_battery, PANEL_BATTERY);
+    graphics_draw_bitmap_in_rect(ctx, s_shown.bt_connected ? img_bt_connect : img_bt_disconnect, PANEL_BT);
+  }
+}
+
+static void separator_update_proc(Layer *layer, GContext *ctx) {
+  graphics_context_set_fill_color(ctx, GColorWhite);
+  for (size_t i = 0; i < ARRAY_LENGTH(SEPARATOR_DOTS); i++) {
+    graphics_fill_rect(ctx, SEPARATOR_DOTS[i], 0, GCornerNone);
+  }
+}
+
 void window_load(Window *window){
   window_layer = window_get_root_layer(window);
 	
@@ -304,14 +653,9 @@ void window_load(Window *window){
   }
 	
 	
-  background_image = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BACKGROUND);
-  BitmapLayer *background_image_layer = bitmap_layer_create(GRect(6, 81, 132, 72));
-  bitmap_layer_set_bitmap(background_image_layer, background_image);
-  layer_add_child(window_layer, (Layer *) background_image_layer);
-
-	
   if (!clock_is_24h_style()) {
   s_time_format_bitmap = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_AM_MODE);
+  perf_resource_load();
 #ifdef PBL_PLATFORM_BASALT
   GRect bitmap_bounds = gbitmap_get_bounds(s_time_format_bitmap);
 #else
@@ -324,118 +668,76 @@ void window_load(Window *window){
 //  layer_set_hidden(bitmap_layer_get_layer(s_time_format_layer), true);
   }
 	
-	// layers
+	// panel
 
-  Layer *weather_holder = layer_create(GRect(0, 0, 144, 168 ));
-  layer_add_child(window_layer, weather_holder);
+  background_image = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BACKGROUND);
+  perf_resource_load();
+  for (size_t i = 0; i < ARRAY_LENGTH(PANEL_BACKGROUND_EDGES); i++) {
+    s_background_edges[i] = gbitmap_create_as_sub_bitmap(background_image, PANEL_BACKGROUND_EDGES[i]);
+  }
+  s_date_font = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
+  s_city_font = fonts_get_system_font(FONT_KEY_GOTHIC_18);
 
-  icon_layer = bitmap_layer_create(GRect(7, 81, 128, 68)); // 42,81,58,50
-  layer_add_child(weather_holder, bitmap_layer_get_layer(icon_layer));
+  s_first_frame_drawn = false;
+  s_panel = layer_create(PANEL_FRAME);
+  layer_set_update_proc(s_panel, panel_update_proc);
+  layer_add_child(window_layer, s_panel);
 
-  steelfish = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_STEELFISH_29));
+  s_separator = layer_create(SEPARATOR_FRAME);
+  layer_set_update_proc(s_separator, separator_update_proc);
+  layer_set_hidden(s_separator, true);
+  layer_add_child(window_layer, s_separator);
+  perf_overlay_attach(window_layer);
 
-  temp_layer = text_layer_create(GRect(36, 80, 100, 40));
-  text_layer_set_text_color(temp_layer, GColorBlack);
-  text_layer_set_background_color(temp_layer, GColorClear);
-//  text_layer_set_font(temp_layer, fonts_get_system_font(FONT_KEY_GOTHIC_28_BOLD));
-  text_layer_set_font(temp_layer, steelfish);
-  text_layer_set_text_alignment(temp_layer, GTextAlignmentRight);
-  layer_add_child(weather_holder, text_layer_get_layer(temp_layer));
-	
-  city_layer = text_layer_create(GRect(9, 129, 90, 24));
-  text_layer_set_text_color(city_layer, GColorBlack);
-  text_layer_set_background_color(city_layer, GColorClear);
-  text_layer_set_font(city_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
- // text_layer_set_font(temp_layer, steelfish);	
-  text_layer_set_text_alignment(city_layer, GTextAlignmentLeft);
-  layer_add_child(window_layer, text_layer_get_layer(city_layer));
-	
-  layer_date_text = text_layer_create(GRect(9, 77, 45, 120));
-  text_layer_set_text_color(layer_date_text, GColorBlack);
-  text_layer_set_background_color(layer_date_text, GColorClear);
-  text_layer_set_font(layer_date_text, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
- // text_layer_set_font(layer_date_text, steelfish);	
-  text_layer_set_text_alignment(layer_date_text, GTextAlignmentLeft);
-  layer_add_child(window_layer, text_layer_get_layer(layer_date_text));
-
-	layer_conn_img  = bitmap_layer_create(GRect(121, 114, 11, 18));
-    layer_batt_img  = bitmap_layer_create(GRect(97, 136, 35, 11));
-
-	bitmap_layer_set_bitmap(layer_batt_img, img_battery_100);
-    bitmap_layer_set_bitmap(layer_conn_img, img_bt_connect);
-
-	layer_add_child(window_layer, bitmap_layer_get_layer(layer_batt_img));
-    layer_add_child(window_layer, bitmap_layer_get_layer(layer_conn_img)); 
-
-	// resources
-	img_bt_connect     = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BLUETOOTHON);
-    img_bt_disconnect  = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BLUETOOTHOFF);
-	
-    img_battery_100   = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_090_100);
-    img_battery_90   = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_080_090);
-    img_battery_80   = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_070_080);
-    img_battery_70   = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_060_070);
-    img_battery_60   = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_050_060);
-    img_battery_50   = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_040_050);
-    img_battery_40   = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_030_040);
-    img_battery_30    = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_020_030);
-    img_battery_20    = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_010_020);
-    img_battery_10    = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_000_010);
-    img_battery_charge = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BATT_CHARGING);
-	
 	 // handlers
     battery_state_service_subscribe(&handle_battery);
     bluetooth_connection_service_subscribe(&handle_bluetooth);
 
-	 // draw first frame
+	 // draw first frame: time and date now, the widgets once widgets_load() has run
     force_update();
+    s_view_ready = true;
+    view_commit();
 
 }
 
 void window_unload(Window *window){
 
-  fonts_unload_custom_font(steelfish);  
-	
-  text_layer_destroy( layer_date_text );
-  text_layer_destroy( city_layer );
-  text_layer_destroy( temp_layer );
-
-  layer_remove_from_parent(bitmap_layer_get_layer(icon_layer));
-  bitmap_layer_destroy(icon_layer);
-  gbitmap_destroy(icon_bitmap);
-  icon_bitmap = NULL;
+  s_view_ready = false;
+  s_shown.valid = false;
+  s_shown.widgets_valid = false;
+
+  if (s_widgets_timer) {
+    app_timer_cancel(s_widgets_timer);
+    s_widgets_timer = NULL;
+  }
+  if (s_commit_timer) {
+    app_timer_cancel(s_commit_timer);
+    s_commit_timer = NULL;
+  }
+  if (s_widgets_ready) {
+    widgets_unload();
+  }
 	
-  layer_destroy( weather_holder );
+  perf_overlay_detach();
+  layer_remove_from_parent(s_separator);
+  layer_destroy(s_separator);
+  s_separator = NULL;
+
+  layer_remove_from_parent(s_panel);
+  layer_destroy(s_panel);
+  s_panel = NULL;
 
   layer_remove_from_parent(bitmap_layer_get_layer(s_time_format_layer));
   bitmap_layer_destroy(s_time_format_layer);
   gbitmap_destroy(s_time_format_bitmap);
   s_time_format_bitmap = NULL;
 	
+  for (size_t i = 0; i < ARRAY_LENGTH(s_background_edges); i++) {
+    gbitmap_destroy(s_background_edges[i]);
+    s_background_edges[i] = NULL;
+  }
   gbitmap_destroy(background_image);
-  bitmap_layer_destroy(background_image_layer);
   background_image = NULL;
-
-  layer_remove_from_parent(bitmap_layer_get_layer(layer_batt_img));
-  bitmap_layer_destroy(layer_batt_img);
-  gbitmap_destroy(img_battery_100);
-  gbitmap_destroy(img_battery_90);
-  gbitmap_destroy(img_battery_80);
-  gbitmap_destroy(img_battery_70);
-  gbitmap_destroy(img_battery_60);
-  gbitmap_destroy(img_battery_50);
-  gbitmap_destroy(img_battery_40);
-  gbitmap_destroy(img_battery_30);
-  gbitmap_destroy(img_battery_20);
-  gbitmap_destroy(img_battery_10);
-  gbitmap_destroy(img_battery_charge);
-
-  layer_remove_from_parent(bitmap_layer_get_layer(layer_conn_img));
-  bitmap_layer_destroy(layer_conn_img);
-  gbitmap_destroy(img_bt_connect);
-  gbitmap_destroy(img_bt_disconnect);
-  img_bt_connect = NULL;
-  img_bt_disconnect = NULL;
 	
   for (int i=0; i<4; i++){
 	layer_remove_from_parent(slide_layer_get_layer(slide_layer[i]));
@@ -449,12 +751,14 @@ void window_unload(Window *window){
 }
 
 void handle_init(void) {
+  time_ms(&s_launch_s, &s_launch_ms);
+  trace_begin();
+
   window = window_create();
 	  window_set_background_color(window, GColorBlack);
 
-  const int inbound_size = 128;
-  const int outbound_size = 128;
-  app_message_open(inbound_size, outbound_size);	
+  link_open();
+  ledger_open(battery_state_service_peek(), bluetooth_connection_service_peek());
 	
 char *sys_locale = setlocale(LC_ALL, "");
   // we're not supporting chinese yet
@@ -467,22 +771,41 @@ char *sys_locale = setlocale(LC_ALL, "");
   		.unload = window_unload,
       });
 
+  // nothing is known until the first tick and the service peeks in window_load
+  memset(s_view.digits, 0xFF, sizeof(s_view.digits));
+  s_view.battery = ATLAS_BATTERY_090_100;
+  s_view.bt_connected = true;
+  s_view.weather_icon = 14;
+
+  // last known weather until the phone answers; N/A and blanks on a first launch
+  uint8_t weather_payload[WEATHER_PAYLOAD_SIZE] = { 0 };
+  if (weather_cache_load()) weather_pack(&s_weather_cache.report, weather_payload);
+  forecast_load();
+  s_view.weather_stale = weather_cache_stale(time(NULL));
+  uint8_t forecast_placeholder = 0;
+
   Tuplet initial_values[] = {
-    TupletInteger(WEATHER_ICON_KEY, (uint8_t) 14),
-	TupletCString(CITY_KEY, ""),
-    TupletCString(WEATHER_TEMPERATURE_KEY, ""),
+    TupletBytes(WEATHER_KEY, weather_payload, sizeof(weather_payload)),
+    TupletBytes(FORECAST_KEY, &forecast_placeholder, sizeof(forecast_placeholder)),
     TupletInteger(INVERT_COLOR_KEY, persist_read_bool(INVERT_COLOR_KEY)),
 	TupletInteger(BLUETOOTHVIBE_KEY, persist_read_bool(BLUETOOTHVIBE_KEY)),
+    TupletInteger(ANIMATION_KEY, (uint8_t) persist_read_int(ANIMATION_KEY)),
+    TupletInteger(BLINK_KEY, persist_read_bool(BLINK_KEY)),
+    TupletInteger(REQUEST_LEDGER_KEY, (uint32_t) 0),
 //    TupletInteger(HOURLYVIBE_KEY, persist_read_bool(HOURLYVIBE_KEY)),
   };
 
   app_sync_init(&sync, sync_buffer, sizeof(sync_buffer), initial_values,
                 ARRAY_LENGTH(initial_values), sync_tuple_changed_callback,
-                NULL, NULL);
+                link_sync_error, NULL);
 
   appStarted = true;
 
-  tick_timer_service_subscribe(MINUTE_UNIT, (TickHandler) tick_handler);
+  // the watch decides when the phone fetches weather; a missing or old cache asks right away
+  link_set_forecast(forecast_until());
+  link_schedule_start(s_weather_cache.updated);
+
+  tick_subscribe();
 
   window_stack_push(window, true);
 
@@ -491,10 +814,16 @@ char *sys_locale = setlocale(LC_ALL, "");
 void handle_deinit(void) {
 	
   app_sync_deinit(&sync);
+  appStarted = false;
+  link_close();
   tick_timer_service_unsubscribe();
   battery_state_service_unsubscribe();
   bluetooth_connection_service_unsubscribe();
   window_destroy(window);
+
+  ledger_close();
+  perf_end();
+  trace_end();
 }
 
 int main(void) {
@@ -0,0 +1,110 @@
+#include <pebble.h>
+#include "perf.h"
+
+#ifdef PERF_COUNTERS
+
+#define PERF_LOG_MINUTES 15
+
+#ifdef PERF_OVERLAY
+#define PERF_OVERLAY_HEIGHT 14
+#endif
+
+// the current window only; perf_log() starts a new one
+typedef struct {
+  uint32_t calls;
+  uint32_t total_ms;
+} PerfCounter;
+
+static const char *const SITE_NAMES[PERF_SITE_COUNT] = {
+  "tick", "slide", "frame", "sync", "battery", "second"
+};
+
+static PerfCounter s_counters[PERF_SITE_COUNT];
+static size_t s_heap_peak = 0;
+static uint32_t s_resource_loads = 0;
+static uint16_t s_minutes = 0;
+
+#ifdef PERF_OVERLAY
+static TextLayer *s_overlay = NULL;
+static char s_overlay_text[48];
+
+static void perf_overlay_update(void) {
+  if (s_overlay == NULL) return;
+
+  uint32_t busy_ms = 0;
+  for (int i = 0; i < PERF_SITE_COUNT; i++) busy_ms += s_counters[i].total_ms;
+  snprintf(s_overlay_text, sizeof(s_overlay_text), "%lums/%um f%lu h%u r%lu",
+           (unsigned long) busy_ms, s_minutes, (unsigned long) s_counters[PERF_FRAME].calls,
+           (unsigned) s_heap_peak, (unsigned long) s_resource_loads);
+  text_layer_set_text(s_overlay, s_overlay_text);
+}
+#else
+#define perf_overlay_update()
+#endif
+
+PerfMark perf_mark(void) {
+  PerfMark mark;
+  time_ms(&mark.s, &mark.ms);
+  return mark;
+}
+
+void perf_record(PerfSite site, PerfMark start) {
+  PerfMark now = perf_mark();
+  uint32_t elapsed = (uint32_t) (now.s - start.s) * 1000 + now.ms - start.ms;
+
+  s_counters[site].calls++;
+  s_counters[site].total_ms += elapsed;
+
+  size_t heap = heap_bytes_used();
+  if (heap > s_heap_peak) s_heap_peak = heap;
+}
+
+void perf_resource_load(void) {
+  s_resource_loads++;
+}
+
+static void perf_log(void) {
+  for (int i = 0; i < PERF_SITE_COUNT; i++) {
+    const PerfCounter *counter = &s_counters[i];
+    APP_LOG(APP_LOG_LEVEL_INFO, "PERF %s: %lu calls, %lu ms in %u min, %lu us per call", SITE_NAMES[i],
+            (unsigned long) counter->calls, (unsigned long) counter->total_ms, s_minutes,
+            (unsigned long) (counter->calls ? counter->total_ms * 1000 / counter->calls : 0));
+  }
+  APP_LOG(APP_LOG_LEVEL_INFO, "PERF heap peak %u bytes, %lu resource loads",
+          (unsigned) s_heap_peak, (unsigned long) s_resource_loads);
+  memset(s_counters, 0, sizeof(s_counters));
+  s_minutes = 0;
+}
+
+void perf_minute(void) {
+  if (++s_minutes >= PERF_LOG_MINUTES) {
+    perf_log();
+  }
+  perf_overlay_update();
+}
+
+void perf_end(void) {
+  perf_log();
+}
+
+#endif
+
+#ifdef PERF_OVERLAY
+
+void perf_overlay_attach(Layer *parent) {
+  GRect bounds = layer_get_bounds(parent);
+  s_overlay = text_layer_create(GRect(0, bounds.size.h - PERF_OVERLAY_HEIGHT, bounds.size.w, PERF_OVERLAY_HEIGHT));
+  text_layer_set_background_color(s_overlay, GColorBlack);
+  text_layer_set_text_color(s_overlay, GColorWhite);
+  text_layer_set_font(s_overlay, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+  layer_add_child(parent, text_layer_get_layer(s_overlay));
+  perf_overlay_update();
+}
+
+void perf_overlay_detach(void) {
+  layer_remove_from_parent(text_layer_get_layer(s_overlay));
+  text_layer_destroy(s_overlay);
+  s_overlay = NULL;
+}
+
+#endif
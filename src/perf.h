@@ -0,0 +1,75 @@
+#pragma once
+
+#include <pebble.h>
+
+#if defined(PERF_OVERLAY) && !defined(PERF_COUNTERS)
+#define PERF_COUNTERS
+#endif
+
+// Performance counters, built only with `pebble build -- --perf` (PERF_COUNTERS); add
+// `--perf-overlay` (PERF_OVERLAY) to also show them in a strip along the bottom of the screen,
+// below the weather panel, where it covers nothing of the face.
+// Each instrumented site counts its calls and the time spent in it, and every exit samples
+// heap_bytes_used() for the high-water mark. time_ms() is the finest clock an app has, and most
+// calls finish within a millisecond, so a single call reads 0 or 1 ms: whether it happened to
+// straddle a millisecond boundary. Only the sum over many calls means anything (the chance of
+// straddling one is the call's share of a millisecond), so time is reported per window: a
+// "PERF" line per site goes to the app log every PERF_LOG_MINUTES with the window's calls, the
+// milliseconds they took and the average per call, then the window starts over; the last
+// window is logged when the app exits. Without PERF_COUNTERS every call below compiles to
+// nothing.
+
+typedef enum {
+  PERF_TICK,      // tick_handler
+  PERF_SLIDE,     // slide_layer_animate_to
+  PERF_FRAME,     // animation frame updates of the digit driver
+  PERF_SYNC,      // sync_tuple_changed_callback
+  PERF_BATTERY,   // handle_battery
+  PERF_SECOND,    // second_handler, seconds mode only
+  PERF_SITE_COUNT
+} PerfSite;
+
+#ifdef PERF_COUNTERS
+
+typedef struct {
+  time_t   s;
+  uint16_t ms;
+} PerfMark;
+
+PerfMark perf_mark(void);
+void perf_record(PerfSite site, PerfMark start);
+
+// brackets a site within one block: perf_enter(PERF_TICK); ... perf_leave(PERF_TICK);
+#define perf_enter(site) PerfMark perf_start_##site = perf_mark()
+#define perf_leave(site) perf_record(site, perf_start_##site)
+
+// after every gbitmap_create_with_resource()
+void perf_resource_load(void);
+
+// minute tick: logs the summary when it is due and refreshes the overlay
+void perf_minute(void);
+
+// logs the session's summary
+void perf_end(void);
+
+#else
+
+#define perf_enter(site)
+#define perf_leave(site)
+#define perf_resource_load()
+#define perf_minute()
+#define perf_end()
+
+#endif
+
+#ifdef PERF_OVERLAY
+
+void perf_overlay_attach(Layer *parent);
+void perf_overlay_detach(void);
+
+#else
+
+#define perf_overlay_attach(parent)
+#define perf_overlay_detach()
+
+#endif
@@ -1,53 +1,346 @@
 
 #include <pebble.h>
 #include "slide_layer.h"
+#include "atlas.h"
+#include "perf.h"
+#include "ledger.h"
 
 // Animation duration & delay  
 #define ANIMATION_DURATION 2000
+// SLIDE_QUALITY_REDUCED: a shorter slide, drawn in this many steps rather than every frame
+#define ANIMATION_REDUCED_DURATION 600
+#define ANIMATION_REDUCED_STEPS 3
 #define ANIMATION_DELAY 0  
+// Delay between consecutive digits changing in the same tick, 0 = all together
+#define ANIMATION_STAGGER 0
   
-// Animation initial horizontal pozition: -1 = from left, 0 = center, 1 = from right
+// Default animation initial horizontal pozition: -1 = from left, 0 = center, 1 = from right
 #define ANIM_START_X  0
-// Animation initial vertical pozition: -1 = from top, 0 = center, 1 = from bottom
+// Default animation initial vertical pozition: -1 = from top, 0 = center, 1 = from bottom
 #define ANIM_START_Y 1  
-// you can combine both  
+// you can combine both; slide_layer_set_direction() changes them per layer
+#define ANIM_MODE SLIDE_MODE_SLIDE
+
+#define NO_DIGIT 0xFF
   
   
-// array of resources IDs for numbers
-int NUM_NUM[] = {RESOURCE_ID_IMAGE_NUM_0, RESOURCE_ID_IMAGE_NUM_1, RESOURCE_ID_IMAGE_NUM_2, RESOURCE_ID_IMAGE_NUM_3, RESOURCE_ID_IMAGE_NUM_4,
-                 RESOURCE_ID_IMAGE_NUM_5, RESOURCE_ID_IMAGE_NUM_6, RESOURCE_ID_IMAGE_NUM_7, RESOURCE_ID_IMAGE_NUM_8, RESOURCE_ID_IMAGE_NUM_9};
+// digit glyphs shared by all slide layers: views into the digit atlas, created once when the
+// first layer is created and released when the last one is destroyed. Layers only ever hold
+// borrowed pointers.
+static GBitmap *s_digit_glyphs[ATLAS_DIGITS_COUNT];
+// one more view, narrowed to whatever part of a digit is being drawn; drawing is never reentrant
+static GBitmap *s_glyph_slice;
+static int s_glyph_refs = 0;
 
+static void glyph_cache_retain(void) {
+  if (s_glyph_refs++ > 0) return;
+
+  atlas_retain(ATLAS_DIGITS);
+  for (int i = 0; i < ATLAS_DIGITS_COUNT; i++) {
+    s_digit_glyphs[i] = atlas_create_bitmap(ATLAS_DIGITS, i);
+  }
+  s_glyph_slice = atlas_create_bitmap(ATLAS_DIGITS, 0);
+}
+
+static void glyph_cache_release(void) {
+  if (s_glyph_refs == 0 || --s_glyph_refs > 0) return;
+
+  for (int i = 0; i < ATLAS_DIGITS_COUNT; i++) {
+    gbitmap_destroy(s_digit_glyphs[i]);
+    s_digit_glyphs[i] = NULL;
+  }
+  gbitmap_destroy(s_glyph_slice);
+  s_glyph_slice = NULL;
+  atlas_release(ATLAS_DIGITS);
+}
+
+
+// One animation drives every digit that changes in the same tick, so a minute change costs a
+// single timer and a single frame update however many digits move. Each layer owns its slot
+// (SlideLayer.anim) and joins the running driver through slide_layer_animate_to(); slot n of a
+// batch starts n * ANIMATION_STAGGER after the first.
+//
+// On aplite the driver is an Animation, created once and rescheduled for every batch. Colour
+// platforms destroy an Animation as soon as it stops, so there the driver is a frame timer
+// instead, re-armed every DRIVER_FRAME_MS while a batch runs. Either way steady-state digit
+// changes create nothing.
+#define DRIVER_MAX_LAYERS 4
+
+static SlideLayer *s_layers[DRIVER_MAX_LAYERS];
+static SlideQuality s_quality = SLIDE_QUALITY_FULL;
+static int32_t s_duration = ANIMATION_DURATION; // of one slide at s_quality
+static bool s_driver_running = false;
+static int32_t s_elapsed = 0; // ms into the running driver
+#ifdef PBL_COLOR
+#define DRIVER_FRAME_MS 33
+static AppTimer *s_driver_timer = NULL;
+static uint32_t s_driver_start_ms; // when the running driver's clock reads 0
+#else
+static Animation *s_driver = NULL;
+static bool s_driver_restarting = false; // stop callbacks from our own unschedule are ignored
+#endif
+
+static GRect rect_intersect(GRect a, GRect b) {
+  int16_t x0 = a.origin.x > b.origin.x ? a.origin.x : b.origin.x;
+  int16_t y0 = a.origin.y > b.origin.y ? a.origin.y : b.origin.y;
+  int16_t x1 = a.origin.x + a.size.w < b.origin.x + b.size.w ? a.origin.x + a.size.w : b.origin.x + b.size.w;
+  int16_t y1 = a.origin.y + a.size.h < b.origin.y + b.size.h ? a.origin.y + a.size.h : b.origin.y + b.size.h;
+  return x1 > x0 && y1 > y0 ? GRect(x0, y0, x1 - x0, y1 - y0) : GRectZero;
+}
+
+// draws the part of digit, placed at origin, that lies within area
+static void draw_digit_part(GContext *ctx, uint8_t digit, GSize size, GPoint origin, GRect area) {
+  GRect glyph = { origin, size };
+  GRect visible = rect_intersect(glyph, area);
+  if (visible.size.w == 0) return;
+
+  if (grect_equal(&visible, &glyph)) {
+    graphics_draw_bitmap_in_rect(ctx, s_digit_glyphs[digit], glyph);
+    return;
+  }
+  atlas_set_member_slice(s_glyph_slice, ATLAS_DIGITS, digit,
+                         GRect(visible.origin.x - origin.x, visible.origin.y - origin.y, visible.size.w, visible.size.h));
+  graphics_draw_bitmap_in_rect(ctx, s_glyph_slice, visible);
+}
+
+static void slide_layer_update_proc(Layer *layer, GContext *ctx) {
+  SlideLayer *slide_layer = *(SlideLayer **) layer_get_data(layer);
+  GRect bounds = layer_get_bounds(layer);
+  GPoint at = slide_layer->position;
+
+  if (slide_layer->current_Digit < ATLAS_DIGITS_COUNT) {
+    draw_digit_part(ctx, slide_layer->current_Digit, bounds.size, at, bounds);
+  }
+
+  uint8_t previous = slide_layer->previous_Digit;
+  if (previous >= ATLAS_DIGITS_COUNT || gpoint_equal(&at, &GPointZero)) return;
+
+  if (slide_layer->mode == SLIDE_MODE_PUSH) {
+    // the old digit leads the new one by a full digit
+    GPoint ahead = GPoint(at.x - bounds.size.w * slide_layer->direction_x, at.y - bounds.size.h * slide_layer->direction_y);
+    draw_digit_part(ctx, previous, bounds.size, ahead, bounds);
+    return;
+  }
+
+  // the old digit stays put: draw the band the new one has not covered yet above or below it,
+  // then the one beside it
+  GRect rows = bounds;
+  if (at.y > 0) {
+    draw_digit_part(ctx, previous, bounds.size, GPointZero, GRect(0, 0, bounds.size.w, at.y));
+    rows = GRect(0, at.y, bounds.size.w, bounds.size.h - at.y);
+  } else if (at.y < 0) {
+    draw_digit_part(ctx, previous, bounds.size, GPointZero, GRect(0, bounds.size.h + at.y, bounds.size.w, -at.y));
+    rows = GRect(0, 0, bounds.size.w, bounds.size.h + at.y);
+  }
+  if (at.x > 0) {
+    draw_digit_part(ctx, previous, bounds.size, GPointZero, GRect(0, rows.origin.y, at.x, rows.size.h));
+  } else if (at.x < 0) {
+    draw_digit_part(ctx, previous, bounds.size, GPointZero,
+                    GRect(bounds.size.w + at.x, rows.origin.y, -at.x, rows.size.h));
+  }
+}
+
+static int32_t driver_duration(void) {
+  return s_duration + (DRIVER_MAX_LAYERS - 1) * ANIMATION_STAGGER;
+}
+
+// places the incoming digit t ms into its own slide
+static void slot_set_progress(SlideLayer *slide_layer, int32_t t) {
+  if (t < 0) t = 0;
+  if (t > s_duration) t = s_duration;
+  if (s_quality == SLIDE_QUALITY_REDUCED) {
+    // hold each step until the next one: the frames in between leave the layer clean
+    int32_t step = s_duration / ANIMATION_REDUCED_STEPS;
+    t = t < s_duration ? t / step * step : s_duration;
+  }
+
+  GSize size = layer_get_bounds(slide_layer->layer).size;
+  int32_t remaining = s_duration - t;
+  GPoint position = GPoint(size.w * slide_layer->direction_x * remaining / s_duration,
+                           size.h * slide_layer->direction_y * remaining / s_duration);
+  if (!gpoint_equal(&position, &slide_layer->position)) {
+    slide_layer->position = position;
+    layer_mark_dirty(slide_layer->layer);
+  }
+}
+
+// lands the incoming digit; the outgoing one is gone from then on
+static void slot_land(SlideLayer *slide_layer) {
+  slot_set_progress(slide_layer, s_duration);
+  slide_layer->previous_Digit = NO_DIGIT;
+  slide_layer->anim.state = SLIDE_IDLE;
+}
+
+static bool slots_idle(void) {
+  for (int i = 0; i < DRIVER_MAX_LAYERS; i++) {
+    if (s_layers[i] && s_layers[i]->anim.state != SLIDE_IDLE) return false;
+  }
+  return true;
+}
+
+// one frame of the driver, elapsed ms into it
+static void driver_advance(int32_t elapsed) {
+  perf_enter(PERF_FRAME);
+  ledger_frame();
+  s_elapsed = elapsed;
+
+  for (int i = 0; i < DRIVER_MAX_LAYERS; i++) {
+    SlideLayer *slide_layer = s_layers[i];
+    if (slide_layer && slide_layer->anim.state != SLIDE_IDLE) {
+      slot_set_progress(slide_layer, s_elapsed - slide_layer->anim.offset);
+    }
+  }
+  perf_leave(PERF_FRAME);
+}
+
+// the driver ran its course: every slot still sliding lands
+static void driver_finish(void) {
+  for (int i = 0; i < DRIVER_MAX_LAYERS; i++) {
+    if (s_layers[i] && s_layers[i]->anim.state != SLIDE_IDLE) slot_land(s_layers[i]);
+  }
+  s_driver_running = false;
+  s_elapsed = 0;
+}
+
+#ifdef PBL_COLOR
+
+static uint32_t driver_now_ms(void) {
+  time_t s;
+  uint16_t ms;
+  time_ms(&s, &ms);
+  return (uint32_t) s * 1000 + ms;
+}
+
+static void driver_frame(void *context) {
+  int32_t elapsed = (int32_t) (driver_now_ms() - s_driver_start_ms);
+  if (elapsed >= driver_duration()) {
+    s_driver_timer = NULL;
+    driver_advance(driver_duration());
+    driver_finish();
+    return;
+  }
+  s_driver_timer = app_timer_register(DRIVER_FRAME_MS, driver_frame, NULL);
+  driver_advance(elapsed > 0 ? elapsed : 0);
+}
+
+#else
+
+static void driver_update(Animation *anim, const uint32_t progress) {
+  driver_advance((int32_t) progress * driver_duration() / ANIMATION_NORMALIZED_MAX);
+}
+
+static const AnimationImplementation s_driver_impl = {
+  .update = driver_update
+};
+
+static void driver_stopped(Animation *anim, bool finished, void *context) {
+  if (s_driver_restarting) return;
+  driver_finish();
+}
+
+#endif
+
+static void driver_halt(void) {
+  if (!s_driver_running) return;
+
+  #ifdef PBL_COLOR
+    app_timer_cancel(s_driver_timer);
+    s_driver_timer = NULL;
+  #else
+    s_driver_restarting = true;
+    animation_unschedule(s_driver);
+    s_driver_restarting = false;
+  #endif
+  s_driver_running = false;
+}
+
+// (re)starts the driver; slots already sliding are rebased so they carry on where they were
+static void driver_start(uint32_t delay) {
+  for (int i = 0; i < DRIVER_MAX_LAYERS; i++) {
+    if (s_layers[i]) s_layers[i]->anim.offset -= s_elapsed;
+  }
+  s_elapsed = 0;
+
+  driver_halt();
+
+  #ifdef PBL_COLOR
+    s_driver_start_ms = driver_now_ms() + delay;
+    s_driver_timer = app_timer_register(delay, driver_frame, NULL);
+  #else
+    if (s_driver == NULL) {
+      s_driver = animation_create();
+      animation_set_implementation(s_driver, &s_driver_impl);
+      animation_set_handlers(s_driver, (AnimationHandlers) {
+        .stopped = driver_stopped
+      }, NULL);
+      animation_set_curve(s_driver, AnimationCurveLinear);
+    }
+    animation_set_duration(s_driver, driver_duration());
+    animation_set_delay(s_driver, delay);
+    animation_schedule(s_driver);
+  #endif
+  s_driver_running = true;
+}
+
+static void driver_destroy(void) {
+  driver_halt();
+
+  #ifndef PBL_COLOR
+    if (s_driver) animation_destroy(s_driver);
+    s_driver = NULL;
+  #endif
+}
+
+// start of the next slot in the current batch
+static int32_t driver_next_offset(void) {
+  int32_t offset = s_elapsed;
+  for (int i = 0; i < DRIVER_MAX_LAYERS; i++) {
+    SlideLayer *slide_layer = s_layers[i];
+    if (slide_layer && slide_layer->anim.state != SLIDE_IDLE &&
+        slide_layer->anim.offset + ANIMATION_STAGGER > offset) {
+      offset = slide_layer->anim.offset + ANIMATION_STAGGER;
+    }
+  }
+  return offset;
+}
+
+static bool driver_register(SlideLayer *slide_layer) {
+  for (int i = 0; i < DRIVER_MAX_LAYERS; i++) {
+    if (s_layers[i] == NULL) {
+      s_layers[i] = slide_layer;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void driver_unregister(SlideLayer *slide_layer) {
+  bool empty = true;
+  for (int i = 0; i < DRIVER_MAX_LAYERS; i++) {
+    if (s_layers[i] == slide_layer) s_layers[i] = NULL;
+    if (s_layers[i]) empty = false;
+  }
+  if (empty) driver_destroy();
+}
 
-// animation stop callback 
-void on_animation_stopped(Animation *anim, bool finished, SlideLayer *slide_layer)
-{
-  
-   // destroying animation, but only in applite
-   #ifndef PBL_COLOR
-      property_animation_destroy((PropertyAnimation*) anim);
-   #endif
-  
-   // destroying old bitmap in static layer if it exists
-   GBitmap *old_bitmap = (GBitmap *)bitmap_layer_get_bitmap(slide_layer->static_bitmap_layer);
-   if (old_bitmap) gbitmap_destroy(old_bitmap);
-  
-   // saving new bitmap in static layer
-   bitmap_layer_set_bitmap(slide_layer->static_bitmap_layer, slide_layer->gbitmap_digit);
-}  
-  
 SlideLayer* slide_layer_create(GRect frame) {
   
   SlideLayer* slide_layer = malloc(sizeof(SlideLayer)); // allocating memory for side_layer items
 
-	slide_layer->layer = layer_create(frame); // creating main layer
-  slide_layer->current_Digit = -1;
+	slide_layer->layer = layer_create_with_data(frame, sizeof(SlideLayer *)); // creating main layer
+  *(SlideLayer **) layer_get_data(slide_layer->layer) = slide_layer;
+  layer_set_update_proc(slide_layer->layer, slide_layer_update_proc);
+  slide_layer->current_Digit = NO_DIGIT;
+  slide_layer->previous_Digit = NO_DIGIT;
+  slide_layer->mode = ANIM_MODE;
+  slide_layer->direction_x = ANIM_START_X;
+  slide_layer->direction_y = ANIM_START_Y;
+  slide_layer->position = GPointZero;
+  slide_layer->anim.state = SLIDE_IDLE;
+  slide_layer->anim.offset = 0;
+  slide_layer->anim.animated = driver_register(slide_layer);
   
-  // creating bitmap layers
-  GRect bound = GRect(0, 0, frame.size.w, frame.size.h);
-  slide_layer->static_bitmap_layer = bitmap_layer_create(bound);
-  layer_add_child(slide_layer->layer, bitmap_layer_get_layer(slide_layer->static_bitmap_layer));
-  slide_layer->anim_bitmap_layer = bitmap_layer_create(bound);
-  layer_add_child(slide_layer->layer, bitmap_layer_get_layer(slide_layer->anim_bitmap_layer));
+  glyph_cache_retain();
   
   return slide_layer;                    
 
@@ -55,11 +348,12 @@ SlideLayer* slide_layer_create(GRect frame) {
 
 void slide_layer_destroy(SlideLayer *slide_layer) {
   
-  if (slide_layer->gbitmap_digit) gbitmap_destroy(slide_layer->gbitmap_digit);
-  bitmap_layer_destroy(slide_layer->static_bitmap_layer);
-  bitmap_layer_destroy(slide_layer->anim_bitmap_layer);
+  slide_layer_cancel(slide_layer);
+  if (slide_layer->anim.animated) driver_unregister(slide_layer);
   layer_destroy(slide_layer->layer);
   free(slide_layer);
+  
+  glyph_cache_release();
 
 }
 
@@ -67,32 +361,80 @@ Layer* slide_layer_get_layer(SlideLayer *slide_layer){
   return slide_layer->layer;
 }
 
-void slide_layer_animate_to(SlideLayer *slide_layer, uint8_t next_value){
+void slide_layer_set_mode(SlideLayer *slide_layer, SlideMode mode) {
+  slide_layer->mode = mode;
+}
+
+void slide_layer_set_direction(SlideLayer *slide_layer, int8_t x, int8_t y) {
+  slide_layer->direction_x = x;
+  slide_layer->direction_y = y;
+}
+
+static void slide_layer_start(SlideLayer *slide_layer, uint8_t next_value) {
+  
+  if (next_value >= ATLAS_DIGITS_COUNT) return;
   
   if (slide_layer->current_Digit != next_value) {
     
+    uint8_t outgoing = slide_layer->current_Digit;
     slide_layer->current_Digit = next_value;
     
-    GRect finish = layer_get_bounds(slide_layer->layer);
-    GRect start = GRect(finish.size.w * ANIM_START_X, finish.size.h * ANIM_START_Y, finish.size.w, finish.size.h);
+    // retargeting: land the digit that was on its way in, then slide the new one over it
+    SlideState next_state = SLIDE_RUNNING;
+    if (slide_layer->anim.state != SLIDE_IDLE) {
+      slot_land(slide_layer);
+      next_state = SLIDE_RETARGETED;
+    }
     
-    Layer *blayer = bitmap_layer_get_layer(slide_layer->anim_bitmap_layer);
-    layer_set_frame(blayer, start);
+    slide_layer->previous_Digit = outgoing;
+    layer_mark_dirty(slide_layer->layer);
     
-    slide_layer->gbitmap_digit = gbitmap_create_with_resource(NUM_NUM[next_value]);
-    bitmap_layer_set_bitmap(slide_layer->anim_bitmap_layer, slide_layer->gbitmap_digit);
+    // layers beyond the driver's capacity just cut to the new digit, as do cut mode and
+    // SLIDE_QUALITY_OFF
+    if (!slide_layer->anim.animated || slide_layer->mode == SLIDE_MODE_CUT || s_quality == SLIDE_QUALITY_OFF) {
+      slot_land(slide_layer);
+      return;
+    }
     
-    slide_layer->anim = property_animation_create_layer_frame(blayer, &start, &finish);
-  
-    AnimationHandlers handlers = {
-        .stopped = (AnimationStoppedHandler) on_animation_stopped
-    };
-    animation_set_handlers((Animation*) slide_layer->anim, handlers, slide_layer);
+    slot_set_progress(slide_layer, 0);
+    slide_layer->anim.offset = driver_next_offset();
+    slide_layer->anim.state = next_state;
     
-    animation_set_curve((Animation*) slide_layer->anim, AnimationCurveLinear);
-    animation_set_duration((Animation*) slide_layer->anim, ANIMATION_DURATION);
-    animation_set_delay((Animation*) slide_layer->anim, ANIMATION_DELAY);
-    animation_schedule((Animation*) slide_layer->anim);
+    // slots joining before the first frame ride along; a driver already under way is restarted
+    if (!s_driver_running) {
+      driver_start(ANIMATION_DELAY);
+    } else if (s_elapsed > 0 && slide_layer->anim.offset + s_duration > driver_duration()) {
+      driver_start(0);
+    }
     
   }
-}
\ No newline at end of file
+}
+
+void slide_layer_animate_to(SlideLayer *slide_layer, uint8_t next_value) {
+  perf_enter(PERF_SLIDE);
+  slide_layer_start(slide_layer, next_value);
+  perf_leave(PERF_SLIDE);
+}
+
+void slide_layer_cancel(SlideLayer *slide_layer) {
+  
+  if (slide_layer->anim.state == SLIDE_IDLE) return;
+  
+  slot_land(slide_layer);
+  
+  if (slots_idle()) {
+    driver_halt();
+    s_elapsed = 0;
+  }
+}
+
+void slide_layer_set_quality(SlideQuality quality) {
+  if (quality == s_quality) return;
+
+  // slides under way land first: their timing belongs to the old quality
+  for (int i = 0; i < DRIVER_MAX_LAYERS; i++) {
+    if (s_layers[i]) slide_layer_cancel(s_layers[i]);
+  }
+  s_quality = quality;
+  s_duration = quality == SLIDE_QUALITY_REDUCED ? ANIMATION_REDUCED_DURATION : ANIMATION_DURATION;
+}
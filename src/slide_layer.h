@@ -3,16 +3,46 @@
 #include <pebble.h>  
 
 
+typedef enum {
+  SLIDE_IDLE,        // showing current_Digit, not on the driver
+  SLIDE_RUNNING,     // sliding current_Digit in
+  SLIDE_RETARGETED   // a new digit arrived mid-slide: the old one landed and this one restarted
+} SlideState;
+
+typedef enum {
+  SLIDE_MODE_SLIDE,  // the new digit slides in over the old one
+  SLIDE_MODE_PUSH,   // the new digit pushes the old one out ahead of it
+  SLIDE_MODE_CUT     // the new digit replaces the old one at once
+} SlideMode;
+
+// how much every layer spends on a transition, whatever its mode (see anim_policy.h)
+typedef enum {
+  SLIDE_QUALITY_FULL,     // a frame per driver update for the whole slide
+  SLIDE_QUALITY_REDUCED,  // a shorter slide in a few steps
+  SLIDE_QUALITY_OFF       // every transition is a cut
+} SlideQuality;
+
+// the layer's slot on the shared animation driver, reused for every transition
+typedef struct {
+  SlideState state;
+  int32_t    offset;   // start of this layer's slide on the driver's clock, in ms
+  bool       animated; // false once the driver is full: digit changes become cuts
+} SlideAnim;
+
+// Draws itself: only the parts of the outgoing and incoming digits that are on screen at the
+// current position are blitted, so a frame touches each pixel of the layer at most once.
 typedef struct {
   Layer       *layer;
-  BitmapLayer *static_bitmap_layer;
-  BitmapLayer *anim_bitmap_layer;
 
-	PropertyAnimation *anim;
-	
-	GBitmap* gbitmap_digit;
-  
 	uint8_t current_Digit;
+	uint8_t previous_Digit;   // sliding out, 0xFF once the new digit has landed
+
+	SlideMode mode;
+	int8_t    direction_x;    // where new digits come from: -1 left, 0 centre, 1 right
+	int8_t    direction_y;    // -1 top, 0 centre, 1 bottom
+	GPoint    position;       // of the incoming digit, GPointZero once landed
+
+	SlideAnim anim;
 
 } SlideLayer;
 
@@ -23,4 +53,15 @@ void slide_layer_destroy(SlideLayer *slide_layer);
 
 Layer* slide_layer_get_layer(SlideLayer *slide_layer);
 
+// takes effect from the next transition
+void slide_layer_set_mode(SlideLayer *slide_layer, SlideMode mode);
+
+void slide_layer_set_direction(SlideLayer *slide_layer, int8_t x, int8_t y);
+
 void slide_layer_animate_to(SlideLayer *slide_layer, uint8_t next_value);
+
+// lands a transition in progress immediately
+void slide_layer_cancel(SlideLayer *slide_layer);
+
+// for all layers; transitions under way land at once
+void slide_layer_set_quality(SlideQuality quality);
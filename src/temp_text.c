@@ -0,0 +1,66 @@
+#include <pebble.h>
+#include "temp_text.h"
+#include "atlas.h"
+
+// the font resource's trackingAdjust, kept so the temperature sets as it did
+#define TEMP_TEXT_TRACKING 1
+#define NO_GLYPH 0xFF
+
+static GBitmap *s_glyph = NULL;
+
+// glyph for the character at *text, advancing past it; degree is the UTF-8 pair C2 B0
+static uint8_t next_glyph(const char **text) {
+  unsigned char c = (unsigned char) *(*text)++;
+  if (c >= '0' && c <= '9') return ATLAS_TEMPERATURE_0 + (c - '0');
+  if (c == '-') return ATLAS_TEMPERATURE_MINUS;
+  if (c == '~') return ATLAS_TEMPERATURE_TILDE;
+  if (c == 0xC2 && (unsigned char) **text == 0xB0) {
+    (*text)++;
+    return ATLAS_TEMPERATURE_DEGREE;
+  }
+  return NO_GLYPH;
+}
+
+void temp_text_load(void) {
+  atlas_retain(ATLAS_TEMPERATURE);
+  s_glyph = atlas_create_bitmap(ATLAS_TEMPERATURE, ATLAS_TEMPERATURE_0);
+}
+
+void temp_text_unload(void) {
+  gbitmap_destroy(s_glyph);
+  s_glyph = NULL;
+  atlas_release(ATLAS_TEMPERATURE);
+}
+
+int16_t temp_text_width(const char *text) {
+  int16_t width = 0;
+  while (*text) {
+    uint8_t glyph = next_glyph(&text);
+    if (glyph == NO_GLYPH) continue;
+    width += atlas_member_size(ATLAS_TEMPERATURE, glyph).w + TEMP_TEXT_TRACKING;
+  }
+  return width > 0 ? width - TEMP_TEXT_TRACKING : 0;
+}
+
+void temp_text_draw(GContext *ctx, const char *text, GRect box, GTextAlignment alignment, GColor color) {
+  if (s_glyph == NULL || text == NULL) return;
+
+  int16_t x = box.origin.x;
+  if (alignment != GTextAlignmentLeft) {
+    int16_t slack = box.size.w - temp_text_width(text);
+    x += alignment == GTextAlignmentRight ? slack : slack / 2;
+  }
+  int16_t y = box.origin.y + ATLAS_TEMPERATURE_TOP;
+
+  // the strip is white ink on black: clearing through it draws black text, or-ing draws white
+  graphics_context_set_compositing_mode(ctx, color == GColorWhite ? GCompOpOr : GCompOpClear);
+  while (*text) {
+    uint8_t glyph = next_glyph(&text);
+    if (glyph == NO_GLYPH) continue;
+
+    GSize size = atlas_member_size(ATLAS_TEMPERATURE, glyph);
+    atlas_set_member(s_glyph, ATLAS_TEMPERATURE, glyph);
+    graphics_draw_bitmap_in_rect(ctx, s_glyph, GRect(x, y, size.w, size.h));
+    x += size.w + TEMP_TEXT_TRACKING;
+  }
+}
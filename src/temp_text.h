@@ -0,0 +1,20 @@
+#pragma once
+
+#include <pebble.h>
+
+
+// Draws the panel's temperature ("72°", "~-5°") from ATLAS_TEMPERATURE, the few Steelfish
+// glyphs the build renders into a strip (tools/atlas.py), instead of loading the whole font.
+// Covers digits, minus, degree and tilde; anything else is skipped.
+
+// retains the strip and creates the one view every glyph is drawn through
+void temp_text_load(void);
+
+void temp_text_unload(void);
+
+// width of text as temp_text_draw lays it out
+int16_t temp_text_width(const char *text);
+
+// draws text in color (black or white) over whatever is underneath, aligned in box; leaves the
+// context's compositing mode changed
+void temp_text_draw(GContext *ctx, const char *text, GRect box, GTextAlignment alignment, GColor color);
@@ -0,0 +1,117 @@
+#include <pebble.h>
+#include "trace.h"
+
+#ifdef TRACE_RECORD
+
+#define TRACE_CHUNK 96 // bytes per logged line, 192 hex characters
+
+static uint8_t s_chunk[TRACE_CHUNK];
+static uint8_t s_used = 0;
+static time_t s_last_s;
+static uint16_t s_last_ms;
+
+static void trace_flush(void) {
+  if (s_used == 0) return;
+
+  static char hex[TRACE_CHUNK * 2 + 1];
+  static const char digits[] = "0123456789abcdef";
+  for (int i = 0; i < s_used; i++) {
+    hex[i * 2] = digits[s_chunk[i] >> 4];
+    hex[i * 2 + 1] = digits[s_chunk[i] & 0xF];
+  }
+  hex[s_used * 2] = '\0';
+  APP_LOG(APP_LOG_LEVEL_INFO, "TRACE %s", hex);
+  s_used = 0;
+}
+
+// records longer than what is left of the chunk carry on in the next one
+static void trace_put(const uint8_t *bytes, uint16_t length) {
+  while (length > 0) {
+    if (s_used == TRACE_CHUNK) trace_flush();
+    uint16_t n = TRACE_CHUNK - s_used < length ? TRACE_CHUNK - s_used : length;
+    memcpy(&s_chunk[s_used], bytes, n);
+    s_used += n;
+    bytes += n;
+    length -= n;
+  }
+}
+
+// kind and time since the previous event; the caller puts the payload after it
+static void trace_event(uint8_t kind) {
+  time_t now_s;
+  uint16_t now_ms;
+  time_ms(&now_s, &now_ms);
+  uint32_t delta = (uint32_t) (now_s - s_last_s) * 1000 + now_ms - s_last_ms;
+  s_last_s = now_s;
+  s_last_ms = now_ms;
+
+  uint8_t record[6]; // kind + at most 5 LEB128 bytes
+  uint8_t n = 0;
+  record[n++] = kind;
+  do {
+    record[n] = delta & 0x7F;
+    delta >>= 7;
+    if (delta) record[n] |= 0x80;
+    n++;
+  } while (delta);
+  trace_put(record, n);
+}
+
+// a u8 key and a u16 length ahead of the value
+static void trace_value(uint8_t kind, const uint8_t *head, uint8_t head_length, const void *value, uint16_t length) {
+  uint8_t size[] = { length & 0xFF, length >> 8 };
+  trace_event(kind);
+  trace_put(head, head_length);
+  trace_put(size, sizeof(size));
+  trace_put(value, length);
+}
+
+void trace_begin(void) {
+  time_ms(&s_last_s, &s_last_ms);
+  s_last_ms = 0; // the header only carries whole seconds
+  uint32_t start = (uint32_t) s_last_s;
+  uint8_t header[] = { 'W', 'T', TRACE_VERSION,
+                       start & 0xFF, (start >> 8) & 0xFF, (start >> 16) & 0xFF, start >> 24 };
+  s_used = 0;
+  APP_LOG(APP_LOG_LEVEL_INFO, "TRACE start");
+  trace_put(header, sizeof(header));
+
+  static uint8_t value[PERSIST_DATA_MAX_LENGTH];
+  for (uint32_t key = 0; key < TRACE_PERSIST_KEYS; key++) {
+    if (!persist_exists(key)) continue;
+    int length = persist_read_data(key, value, sizeof(value));
+    uint8_t head[] = { key };
+    if (length >= 0) trace_value(TRACE_PERSIST, head, sizeof(head), value, length);
+  }
+  trace_flush();
+}
+
+void trace_end(void) {
+  trace_event(TRACE_END);
+  trace_flush();
+}
+
+void trace_tick(void) {
+  trace_event(TRACE_TICK);
+  trace_flush();
+}
+
+void trace_battery(BatteryChargeState charge_state) {
+  uint8_t payload[] = { charge_state.charge_percent,
+                        (charge_state.is_charging ? 1 : 0) | (charge_state.is_plugged ? 2 : 0) };
+  trace_event(TRACE_BATTERY);
+  trace_put(payload, sizeof(payload));
+}
+
+void trace_bluetooth(bool connected) {
+  uint8_t payload[] = { connected };
+  trace_event(TRACE_BLUETOOTH);
+  trace_put(payload, sizeof(payload));
+}
+
+void trace_tuple(const Tuple *tuple) {
+  uint8_t head[] = { (uint8_t) tuple->key, tuple->type };
+  trace_value(TRACE_TUPLE, head, sizeof(head), tuple->value->data, tuple->length);
+}
+
+#endif
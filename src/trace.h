@@ -0,0 +1,47 @@
+#pragma once
+
+#include <pebble.h>
+
+
+// Event trace recorder, built only with `pebble build -- --trace` (TRACE_RECORD).
+// Ticks, battery and Bluetooth changes and AppSync tuples are appended to a small buffer as
+//   u8 kind, LEB128 ms since the previous event, payload
+// after a header of 'W' 'T' u8 version u32 start time. A session opens with a "TRACE start"
+// log line and the snapshot of what the face starts from: every persist key below
+// TRACE_PERSIST_KEYS that exists. The buffer is logged as "TRACE <hex>" lines when it fills and
+// on every minute tick, so a crash loses at most the last minute; a record may run on into the
+// next line. A clean exit ends the session with TRACE_END. host/trace_extract.py turns
+// `pebble logs` output back into the binary trace that host/replay runs.
+
+#define TRACE_VERSION 2
+#define TRACE_PERSIST_KEYS 0x20 // settings, weather cache, forecast and ledger all live below it
+
+enum {
+  TRACE_TICK = 1,       // no payload
+  TRACE_BATTERY = 2,    // u8 percent, u8 flags (bit 0 charging, bit 1 plugged)
+  TRACE_BLUETOOTH = 3,  // u8 connected
+  TRACE_TUPLE = 4,      // u8 key, u8 type, u16 length, value bytes; same-time tuples are one message
+  TRACE_PERSIST = 5,    // u8 key, u16 length, value bytes; only at the start of a session
+  TRACE_END = 6         // no payload
+};
+
+#ifdef TRACE_RECORD
+
+void trace_begin(void);
+void trace_end(void);
+
+void trace_tick(void);
+void trace_battery(BatteryChargeState charge_state);
+void trace_bluetooth(bool connected);
+void trace_tuple(const Tuple *tuple);
+
+#else
+
+#define trace_begin()
+#define trace_end()
+#define trace_tick()
+#define trace_battery(charge_state)
+#define trace_bluetooth(connected)
+#define trace_tuple(tuple)
+
+#endif
@@ -0,0 +1,82 @@
+#include <pebble.h>
+#include "weather.h"
+
+// condition text by Yahoo code, as Yahoo words it in condition.text
+static const char *const CONDITION_TEXT[] = {
+  "Tornado",                 // 0
+  "Tropical Storm",
+  "Hurricane",
+  "Severe Thunderstorms",
+  "Thunderstorms",
+  "Rain And Snow",           // 5
+  "Rain And Sleet",
+  "Snow And Sleet",
+  "Freezing Drizzle",
+  "Drizzle",
+  "Freezing Rain",           // 10
+  "Showers",
+  "Showers",
+  "Snow Flurries",
+  "Light Snow Showers",
+  "Blowing Snow",            // 15
+  "Snow",
+  "Hail",
+  "Sleet",
+  "Dust",
+  "Foggy",                   // 20
+  "Haze",
+  "Smoky",
+  "Blustery",
+  "Windy",
+  "Cold",                    // 25
+  "Cloudy",
+  "Mostly Cloudy",
+  "Mostly Cloudy",
+  "Partly Cloudy",
+  "Partly Cloudy",           // 30
+  "Clear",
+  "Sunny",
+  "Fair",
+  "Fair",
+  "Rain And Hail",           // 35
+  "Hot",
+  "Isolated Thunderstorms",
+  "Scattered Thunderstorms",
+  "Scattered Thunderstorms",
+  "Scattered Showers",       // 40
+  "Heavy Snow",
+  "Scattered Snow Showers",
+  "Heavy Snow",
+  "Partly Cloudy",
+  "Thundershowers",          // 45
+  "Snow Showers",
+  "Isolated Thundershowers",
+};
+
+bool weather_unpack(const uint8_t *data, uint16_t length, WeatherReport *report) {
+  if (length < WEATHER_PAYLOAD_SIZE || data[0] != WEATHER_PROTOCOL_VERSION) return false;
+
+  report->temperature = (int16_t) (data[1] | (data[2] << 8));
+  report->unit = data[3];
+  report->icon = data[4];
+  report->condition = data[5];
+  return true;
+}
+
+void weather_pack(const WeatherReport *report, uint8_t data[WEATHER_PAYLOAD_SIZE]) {
+  data[0] = WEATHER_PROTOCOL_VERSION;
+  data[1] = (uint8_t) (report->temperature & 0xFF);
+  data[2] = (uint8_t) ((uint16_t) report->temperature >> 8);
+  data[3] = report->unit;
+  data[4] = report->icon;
+  data[5] = report->condition;
+}
+
+void weather_format_temperature(const WeatherReport *report, char *buffer, size_t size) {
+  // both units read as a bare degree sign, as the panel always has
+  snprintf(buffer, size, "%d°", report->temperature);
+}
+
+const char* weather_condition_text(uint8_t condition) {
+  return condition < ARRAY_LENGTH(CONDITION_TEXT) ? CONDITION_TEXT[condition] : "";
+}
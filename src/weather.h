@@ -0,0 +1,54 @@
+#pragma once
+
+#include <pebble.h>
+
+
+// AppMessage keys shared with the phone (appKeys in appinfo.json)
+enum WeatherKey {
+//  WEATHER_ICON_KEY = 0x0,        replaced by WEATHER_KEY
+//  WEATHER_TEMPERATURE_KEY = 0x1, replaced by WEATHER_KEY
+  INVERT_COLOR_KEY = 0x2,
+  BLUETOOTHVIBE_KEY = 0x3,
+//  HOURLYVIBE_KEY = 0x4,
+//  CITY_KEY = 0x5,                replaced by WEATHER_KEY
+  WEATHER_KEY = 0x6,               // phone -> watch, packed WeatherReport
+  REQUEST_WEATHER_KEY = 0x7,       // watch -> phone, asks for a fresh WEATHER_KEY
+  FORECAST_KEY = 0x8,              // phone -> watch, hourly forecast (forecast.h)
+  ANIMATION_KEY = 0x9,             // phone -> watch, AnimSetting (anim_policy.h)
+  BLINK_KEY = 0xA,                 // phone -> watch, seconds mode: blink the separator
+  REQUEST_LEDGER_KEY = 0xB,        // phone -> watch, asks for LEDGER_KEY; a new nonzero value each time
+  LEDGER_KEY = 0xC                 // watch -> phone, hourly energy ledger (ledger.h)
+};
+
+// Weather as the phone sends it under WEATHER_KEY: one byte array instead of preformatted
+// strings, the watch renders the text itself.
+//   u8 version, s16 temperature (little endian), u8 unit, u8 icon, u8 condition
+#define WEATHER_PROTOCOL_VERSION 1
+#define WEATHER_PAYLOAD_SIZE 6
+
+typedef enum {
+  WEATHER_UNIT_FAHRENHEIT = 0,
+  WEATHER_UNIT_CELSIUS = 1
+} WeatherUnit;
+
+// Yahoo condition codes 0-47 are sent as is; anything else (3200, "not available") as this
+#define WEATHER_CONDITION_UNKNOWN 0xFF
+
+typedef struct {
+  int16_t temperature;
+  uint8_t unit;       // WeatherUnit
+  uint8_t icon;       // index into WEATHER_ICONS
+  uint8_t condition;  // Yahoo condition code or WEATHER_CONDITION_UNKNOWN
+} WeatherReport;
+
+
+// false when the payload is short or from another protocol version
+bool weather_unpack(const uint8_t *data, uint16_t length, WeatherReport *report);
+
+void weather_pack(const WeatherReport *report, uint8_t data[WEATHER_PAYLOAD_SIZE]);
+
+// "72°"
+void weather_format_temperature(const WeatherReport *report, char *buffer, size_t size);
+
+// condition text for the panel, "" for unknown codes
+const char* weather_condition_text(uint8_t condition);
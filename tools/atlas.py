@@ -0,0 +1,161 @@
+"""Pack families of small images into single sprite-sheet resources.
+
+Each family is stacked vertically into resources/images/atlas_<name>.png
+(plus a ~color sheet when any member has a colour variant) and the member
+rectangles are emitted to src/atlas_table.h, which the runtime uses to hand
+out gbitmap_create_as_sub_bitmap() views. Run from wscript before the
+resources are processed. Every build packs the sheets again from their
+inputs, and a sheet is only written when its bytes change, so whether a
+build touches one depends on content, not on file times (which a fresh
+clone does not keep in commit order).
+
+Glyph families are rendered from a font by glyphs.py instead, one member
+per character laid side by side, so the watch can blit a few characters
+without loading the font. Their header also gets ATLAS_<name>_TOP, the rows
+from the top of a text line in that font to the top of the sheet.
+
+Weather icons are deliberately not packed: only one is shown at a time and
+a 15-icon sheet would keep ~16 KB resident on aplite.
+"""
+
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import pngio
+import glyphs
+
+# (family, resource name, [(member, source image), ...]) -- order is the index
+FAMILIES = [
+    ('DIGITS', 'ATLAS_DIGITS', [
+        ('0', 'num_0.png'), ('1', 'num_1.png'), ('2', 'num_2.png'),
+        ('3', 'num_3.png'), ('4', 'num_4.png'), ('5', 'num_5.png'),
+        ('6', 'num_6.png'), ('7', 'num_7.png'), ('8', 'num_8.png'),
+        ('9', 'num_9.png'),
+    ]),
+    ('BATTERY', 'ATLAS_BATTERY', [
+        ('000_010', '90batt1white.png'), ('010_020', '90batt20white.png'),
+        ('020_030', '90batt30white.png'), ('030_040', '90batt40a.png'),
+        ('040_050', '90batt50white.png'), ('050_060', '90batt60white.png'),
+        ('060_070', '90batt70white.png'), ('070_080', '90batt80white.png'),
+        ('080_090', '90batt90white.png'), ('090_100', '90batt10white.png'),
+        ('CHARGING', '90CHARGINGwhite.png'),
+    ]),
+    ('BLUETOOTH', 'ATLAS_BLUETOOTH', [
+        ('ON', 'bt_connected_90.png'), ('OFF', 'bt_not-connected_90.png'),
+    ]),
+]
+
+# (family, font, pixel size, [(member, character), ...]) -- order is the index
+GLYPH_FAMILIES = [
+    ('TEMPERATURE', 'steelfish rg.ttf', 29, [
+        ('0', '0'), ('1', '1'), ('2', '2'), ('3', '3'), ('4', '4'),
+        ('5', '5'), ('6', '6'), ('7', '7'), ('8', '8'), ('9', '9'),
+        ('MINUS', '-'), ('DEGREE', u'\u00b0'), ('TILDE', '~'),
+    ]),
+]
+
+IMAGES_DIR = os.path.join('resources', 'images')
+FONTS_DIR = os.path.join('resources', 'fonts')
+HEADER = os.path.join('src', 'atlas_table.h')
+
+
+def color_variant(path):
+    base, ext = os.path.splitext(path)
+    return base + '~color' + ext
+
+
+def sheet_path(root, family):
+    return os.path.join(root, IMAGES_DIR, 'atlas_%s.png' % family.lower())
+
+
+def pack_sheet(paths, out_path):
+    return stack_images([pngio.read(p) for p in paths], out_path)
+
+
+def stack_images(images, out_path):
+    width = max(im.width for im in images)
+    sheet = pngio.Image.blank(width, sum(im.height for im in images))
+    rects = []
+    y = 0
+    for im in images:
+        sheet.paste(im, 0, y)
+        rects.append((0, y, im.width, im.height))
+        y += im.height
+    pngio.write(out_path, sheet)
+    return rects
+
+
+def line_images(images, out_path):
+    sheet = pngio.Image.blank(sum(im.width for im in images), max(im.height for im in images))
+    rects = []
+    x = 0
+    for im in images:
+        sheet.paste(im, x, 0)
+        rects.append((x, 0, im.width, im.height))
+        x += im.width
+    pngio.write(out_path, sheet)
+    return rects
+
+
+def render_header(layout, tops):
+    out = ['// Generated by tools/atlas.py -- do not edit.',
+           '#pragma once',
+           '',
+           'typedef enum {']
+    out += ['  ATLAS_%s,' % family for family, _, _ in layout]
+    out += ['  ATLAS_COUNT', '} AtlasId;', '']
+    for family, members, _ in layout:
+        out.append('enum {')
+        out += ['  ATLAS_%s_%s,' % (family, m) for m in members]
+        out += ['  ATLAS_%s_COUNT' % family, '};', '']
+        if family in tops:
+            out += ['#define ATLAS_%s_TOP %d' % (family, tops[family]), '']
+
+    out += ['#ifdef ATLAS_TABLE_IMPLEMENTATION', '',
+            'static const GRect ATLAS_RECTS[] = {']
+    first, start = [], 0
+    for family, _, rects in layout:
+        first.append(start)
+        start += len(rects)
+        out.append('  // %s' % family.lower())
+        out += ['  {{%d, %d}, {%d, %d}},' % r for r in rects]
+    out += ['};', '',
+            'static const AtlasSheet ATLAS_SHEETS[ATLAS_COUNT] = {']
+    for (family, _, rects), start in zip(layout, first):
+        out.append('  { RESOURCE_ID_ATLAS_%s, %d, %d },' % (family, start, len(rects)))
+    out += ['};', '', '#endif', '']
+    return '\n'.join(out)
+
+
+def pack_all(root):
+    layout = []
+    for family, _, members in FAMILIES:
+        sources = [os.path.join(root, IMAGES_DIR, src) for _, src in members]
+        out = sheet_path(root, family)
+        rects = pack_sheet(sources, out)
+
+        colored = [color_variant(p) for p in sources]
+        if any(os.path.exists(p) for p in colored):
+            colored = [c if os.path.exists(c) else p for c, p in zip(colored, sources)]
+            if pack_sheet(colored, color_variant(out)) != rects:
+                raise ValueError('atlas %s: ~color members differ in size' % family)
+
+        layout.append((family, [m for m, _ in members], rects))
+
+    tops = {}
+    for family, font, size, members in GLYPH_FAMILIES:
+        font_path = os.path.join(root, FONTS_DIR, font)
+        images, tops[family] = glyphs.rasterize(font_path, size, [c for _, c in members])
+        rects = line_images(images, sheet_path(root, family))
+        layout.append((family, [m for m, _ in members], rects))
+
+    header = render_header(layout, tops)
+    header_path = os.path.join(root, HEADER)
+    if not os.path.exists(header_path) or open(header_path).read() != header:
+        with open(header_path, 'w') as f:
+            f.write(header)
+
+
+if __name__ == '__main__':
+    pack_all(sys.argv[1] if len(sys.argv) > 1 else '.')
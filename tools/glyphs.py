@@ -0,0 +1,265 @@
+"""Rasterize a handful of TrueType glyphs to 1-bit images.
+
+Used by atlas.py for glyph families: rather than loading a whole custom font
+to draw a few characters, the build renders just those characters into an
+atlas sheet and the watch blits them. Handles what the bundled fonts need:
+glyf outlines (simple and composite), a format 4 cmap and hmtx advances.
+Outlines are filled unhinted with the nonzero rule at 4x4 samples per pixel
+and thresholded at half coverage, which is close to what the SDK's FreeType
+pass makes of the same font at the same size.
+"""
+
+import struct
+
+import pngio
+
+SUPERSAMPLE = 4
+INK = (255, 255, 255, 255)
+PAPER = (0, 0, 0, 255)
+
+
+class Font(object):
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        self.tables = {}
+        count = struct.unpack('>H', self.data[4:6])[0]
+        for i in range(count):
+            tag, _, offset, length = struct.unpack('>4sIII', self.data[12 + 16 * i:28 + 16 * i])
+            self.tables[tag.decode('latin-1')] = (offset, length)
+
+        head = self.table('head')
+        self.units_per_em = struct.unpack('>H', head[18:20])[0]
+        self.long_loca = struct.unpack('>h', head[50:52])[0] == 1
+        self.glyph_count = struct.unpack('>H', self.table('maxp')[4:6])[0]
+        self.metric_count = struct.unpack('>H', self.table('hhea')[34:36])[0]
+        self.cmap = self._read_cmap()
+
+    def table(self, tag):
+        offset, length = self.tables[tag]
+        return self.data[offset:offset + length]
+
+    def _read_cmap(self):
+        cmap = self.table('cmap')
+        count = struct.unpack('>H', cmap[2:4])[0]
+        for i in range(count):
+            platform, encoding, offset = struct.unpack('>HHI', cmap[4 + 8 * i:12 + 8 * i])
+            if (platform, encoding) in ((3, 1), (0, 3)) and struct.unpack('>H', cmap[offset:offset + 2])[0] == 4:
+                return self._read_cmap_format4(cmap, offset)
+        raise ValueError('no unicode format 4 cmap')
+
+    @staticmethod
+    def _read_cmap_format4(cmap, offset):
+        segments = struct.unpack('>H', cmap[offset + 6:offset + 8])[0] // 2
+        ends_at = offset + 14
+        starts_at = ends_at + 2 * segments + 2
+        deltas_at = starts_at + 2 * segments
+        ranges_at = deltas_at + 2 * segments
+        mapping = {}
+        for s in range(segments):
+            end, = struct.unpack('>H', cmap[ends_at + 2 * s:ends_at + 2 * s + 2])
+            start, = struct.unpack('>H', cmap[starts_at + 2 * s:starts_at + 2 * s + 2])
+            delta, = struct.unpack('>h', cmap[deltas_at + 2 * s:deltas_at + 2 * s + 2])
+            range_offset, = struct.unpack('>H', cmap[ranges_at + 2 * s:ranges_at + 2 * s + 2])
+            for code in range(start, end + 1):
+                if code == 0xFFFF:
+                    continue
+                if range_offset == 0:
+                    glyph = (code + delta) & 0xFFFF
+                else:
+                    at = ranges_at + 2 * s + range_offset + 2 * (code - start)
+                    glyph, = struct.unpack('>H', cmap[at:at + 2])
+                    if glyph:
+                        glyph = (glyph + delta) & 0xFFFF
+                if glyph:
+                    mapping[code] = glyph
+        return mapping
+
+    def glyph_index(self, char):
+        if ord(char) not in self.cmap:
+            raise ValueError('font has no glyph for %r' % char)
+        return self.cmap[ord(char)]
+
+    def advance(self, glyph):
+        hmtx = self.table('hmtx')
+        index = min(glyph, self.metric_count - 1)
+        return struct.unpack('>H', hmtx[4 * index:4 * index + 2])[0]
+
+    def _glyph_data(self, glyph):
+        loca = self.table('loca')
+        if self.long_loca:
+            start, end = struct.unpack('>II', loca[4 * glyph:4 * glyph + 8])
+        else:
+            start, end = [2 * v for v in struct.unpack('>HH', loca[2 * glyph:2 * glyph + 4])]
+        offset = self.tables['glyf'][0]
+        return self.data[offset + start:offset + end]
+
+    def contours(self, glyph):
+        """Outline as a list of contours of (x, y, on_curve) in font units."""
+        data = self._glyph_data(glyph)
+        if not data:
+            return []
+        count, = struct.unpack('>h', data[0:2])
+        if count >= 0:
+            return self._simple_contours(data, count)
+        return self._composite_contours(data)
+
+    @staticmethod
+    def _simple_contours(data, count):
+        pos = 10
+        ends = struct.unpack('>%dH' % count, data[pos:pos + 2 * count])
+        pos += 2 * count
+        instructions, = struct.unpack('>H', data[pos:pos + 2])
+        pos += 2 + instructions
+        points = ends[-1] + 1 if count else 0
+
+        flags = []
+        while len(flags) < points:
+            flag = data[pos]
+            pos += 1
+            flags.append(flag)
+            if flag & 8:
+                flags.extend([flag] * data[pos])
+                pos += 1
+
+        def coords(short_bit, same_bit):
+            values, value = [], 0
+            for flag in flags:
+                if flag & short_bit:
+                    delta = data[pos_ref[0]]
+                    pos_ref[0] += 1
+                    value += delta if flag & same_bit else -delta
+                elif not flag & same_bit:
+                    value += struct.unpack('>h', data[pos_ref[0]:pos_ref[0] + 2])[0]
+                    pos_ref[0] += 2
+                values.append(value)
+            return values
+
+        pos_ref = [pos]
+        xs = coords(2, 16)
+        ys = coords(4, 32)
+
+        contours, start = [], 0
+        for end in ends:
+            contours.append([(xs[i], ys[i], bool(flags[i] & 1)) for i in range(start, end + 1)])
+            start = end + 1
+        return contours
+
+    def _composite_contours(self, data):
+        contours, pos, more = [], 10, True
+        while more:
+            flags, glyph = struct.unpack('>HH', data[pos:pos + 4])
+            pos += 4
+            if flags & 1:
+                dx, dy = struct.unpack('>hh', data[pos:pos + 4])
+                pos += 4
+            else:
+                dx, dy = struct.unpack('>bb', data[pos:pos + 2])
+                pos += 2
+            a, b, c, d = 1.0, 0.0, 0.0, 1.0
+            if flags & 8:
+                a = d = struct.unpack('>h', data[pos:pos + 2])[0] / 16384.0
+                pos += 2
+            elif flags & 0x40:
+                a, d = [v / 16384.0 for v in struct.unpack('>hh', data[pos:pos + 4])]
+                pos += 4
+            elif flags & 0x80:
+                a, b, c, d = [v / 16384.0 for v in struct.unpack('>hhhh', data[pos:pos + 8])]
+                pos += 8
+            for contour in self.contours(glyph):
+                contours.append([(a * x + c * y + dx, b * x + d * y + dy, on) for x, y, on in contour])
+            more = flags & 0x20
+        return contours
+
+
+def _flatten(contour, steps=8):
+    """Quadratic outline to a closed polyline."""
+    # TrueType allows runs of off-curve points with implied on-curve midpoints between them
+    points = []
+    n = len(contour)
+    for i in range(n):
+        x, y, on = contour[i]
+        nx, ny, non = contour[(i + 1) % n]
+        points.append((x, y, on))
+        if not on and not non:
+            points.append(((x + nx) / 2.0, (y + ny) / 2.0, True))
+    while not points[0][2]:
+        points.append(points.pop(0))
+
+    line = [points[0][:2]]
+    i, n = 1, len(points)
+    while i <= n:
+        x, y, on = points[i % n]
+        if on:
+            line.append((x, y))
+            i += 1
+            continue
+        x0, y0 = line[-1]
+        x2, y2 = points[(i + 1) % n][:2]
+        for s in range(1, steps + 1):
+            t = s / float(steps)
+            u = 1 - t
+            line.append((u * u * x0 + 2 * u * t * x + t * t * x2, u * u * y0 + 2 * u * t * y + t * t * y2))
+        i += 2
+    return line
+
+
+def _fill(polylines, width, height):
+    """Nonzero coverage mask, thresholded at half the samples, as rows of bools."""
+    edges = []
+    for line in polylines:
+        for (x0, y0), (x1, y1) in zip(line, line[1:] + line[:1]):
+            if y0 != y1:
+                edges.append((x0, y0, x1, y1))
+
+    samples = SUPERSAMPLE
+    coverage = [[0] * width for _ in range(height)]
+    for sy in range(height * samples):
+        y = (sy + 0.5) / samples
+        crossings = []
+        for x0, y0, x1, y1 in edges:
+            if (y0 <= y < y1) or (y1 <= y < y0):
+                crossings.append((x0 + (y - y0) * (x1 - x0) / (y1 - y0), 1 if y1 > y0 else -1))
+        crossings.sort()
+        winding, row = 0, coverage[sy // samples]
+        for (xa, direction), (xb, _) in zip(crossings, crossings[1:]):
+            winding += direction
+            if winding == 0:
+                continue
+            first = max(0, int(xa * samples + 0.5))
+            last = min(width * samples, int(xb * samples + 0.5))
+            for sx in range(first, last):
+                row[sx // samples] += 1
+    half = samples * samples // 2
+    return [[c >= half for c in row] for row in coverage]
+
+
+def rasterize(font_path, size, chars):
+    """Renders chars at size pixels per em.
+
+    Returns (images, top): one image per char, each its advance wide, all
+    cropped to the rows any of them ink, and top, the rows from the top of
+    a size-pixel text line (baseline at size) to the first of those rows.
+    """
+    font = Font(font_path)
+    scale = float(size) / font.units_per_em
+    baseline = size
+
+    masks = []
+    for char in chars:
+        glyph = font.glyph_index(char)
+        width = max(1, int(round(font.advance(glyph) * scale)))
+        height = 2 * size
+        # font units (y up) to pixels (y down) with the baseline at row `baseline`
+        lines = [[(x * scale, baseline - y * scale) for x, y in _flatten(contour)]
+                 for contour in font.contours(glyph)]
+        masks.append(_fill(lines, width, height))
+
+    inked = [y for mask in masks for y, row in enumerate(mask) if any(row)]
+    top, bottom = min(inked), max(inked) + 1
+
+    images = []
+    for mask in masks:
+        rows = [[INK if ink else PAPER for ink in row] for row in mask[top:bottom]]
+        images.append(pngio.Image(len(rows[0]), len(rows), rows))
+    return images, top
@@ -0,0 +1,136 @@
+"""Store each PNG resource at the smallest palette bit depth it allows.
+
+On the colour platforms the firmware decodes a PNG resource into a bitmap
+of the PNG's own format: a 1-, 2- or 4-bit palette PNG becomes a 1-, 2- or
+4-bit palettized GBitmap, anything else an 8-bit one. Most of the face's
+art uses two to sixteen of the 64 Pebble colours, so rewriting it as a
+small palette PNG cuts what gbitmap_create_with_resource() puts on the
+heap by half or more.
+
+~color variants are reduced to the Pebble palette first: the firmware
+turns every PNG colour into a GColor8 with GColorFromRGBA, which keeps
+the top two bits of each channel and of alpha, so a channel is stored as
+the multiple of 85 the watch would show for it anyway. Images without one
+are also what the monochrome build uses, so they are only repacked, never
+changed, and aplite's 1-bit conversion sees the same pixels. Every copy is
+read back and put through the same GColorFromRGBA conversion as the
+original; any difference fails the build.
+
+The sources in resources/ are never written. Run from wscript after
+atlas.py, optimize_all() mirrors every PNG resource, ~color variant
+included, into a directory under build/ and returns the file names the
+resource entries should load instead. Copies are only rewritten when
+their bytes change.
+"""
+
+import json
+import os
+import shutil
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import pngio
+
+IMAGES_DIR = 'resources'
+
+
+def pebble_color(px):
+    """What the colour display makes of an RGBA pixel: GColorFromRGBA keeps the top 2 bits of
+    each channel, scaled back up here so the result is still a PNG colour."""
+    r, g, b, a = [(v >> 6) * 85 for v in px]
+    return (0, 0, 0, 0) if a == 0 else (r, g, b, a)
+
+
+def reduce(image):
+    return pngio.Image(image.width, image.height, [[pebble_color(px) for px in row] for row in image.rows])
+
+
+def heap_bytes(width, height, depth, ctype):
+    """Pixel data and palette of the GBitmap the firmware decodes a PNG into."""
+    if ctype == 3 and depth < 8:
+        return (width * depth + 7) // 8 * height + (1 << depth)
+    return width * height
+
+
+def color_variant(path):
+    base, ext = os.path.splitext(path)
+    return base + '~color' + ext
+
+
+def resource_images(root):
+    """(name, file, colour_file) for each PNG resource; colour_file is its ~color variant or None.
+
+    Files with a ~color variant are only used by aplite, which converts them to 1 bit anyway.
+    """
+    with open(os.path.join(root, 'appinfo.json')) as f:
+        media = json.load(f)['resources']['media']
+    images = []
+    for entry in media:
+        if entry['type'] != 'png':
+            continue
+        colored = color_variant(entry['file'])
+        exists = os.path.exists(os.path.join(root, IMAGES_DIR, colored))
+        images.append((entry['name'], entry['file'], colored if exists else None))
+    return images
+
+
+def _copy(source, target):
+    if os.path.exists(target):
+        with open(source, 'rb') as a, open(target, 'rb') as b:
+            if a.read() == b.read():
+                return
+    shutil.copyfile(source, target)
+
+
+def optimize(path, target_path, colour_only):
+    """Writes path to target_path at its smallest depth; returns (before, after) heap bytes."""
+    width, height, depth, ctype = pngio.ihdr(path)
+    before = heap_bytes(width, height, depth, ctype)
+
+    original = pngio.read(path)
+    image = reduce(original) if colour_only else original
+    target = pngio.palette_depth(len(image.colors()))
+    if target is None or (ctype == 3 and depth <= target):
+        _copy(path, target_path)
+        return before, before
+
+    pngio.write(target_path, image)
+    copy = pngio.read(target_path)
+    if reduce(copy).rows != reduce(original).rows or (not colour_only and copy.rows != original.rows):
+        os.remove(target_path)
+        raise ValueError('%s: %d-bit copy does not display the same' % (path, target))
+    return before, heap_bytes(width, height, target, 3)
+
+
+def optimize_all(root, out_dir, report=sys.stdout):
+    """Mirrors the PNG resources into out_dir at their smallest depth.
+
+    Returns ({resource name: file relative to resources/}, heap bytes before, after).
+    """
+    files, rows, total_before, total_after = {}, [], 0, 0
+    resources = os.path.join(root, IMAGES_DIR)
+    for name, base, colored in resource_images(root):
+        if not os.path.isdir(os.path.dirname(os.path.join(out_dir, base))):
+            os.makedirs(os.path.dirname(os.path.join(out_dir, base)))
+        # the file colour platforms load is the one to shrink; with a ~color variant, the
+        # base file is aplite's alone and goes along unchanged
+        shown = colored or base
+        if colored:
+            _copy(os.path.join(resources, base), os.path.join(out_dir, base))
+        before, after = optimize(os.path.join(resources, shown), os.path.join(out_dir, shown), colored is not None)
+        files[name] = os.path.relpath(os.path.join(out_dir, base), resources)
+        total_before += before
+        total_after += after
+        rows.append((shown, before, after))
+
+    width = max(len(name) for name, _, _ in rows)
+    report.write('%-*s %8s %8s %8s\n' % (width, 'image heap bytes', 'was', 'now', 'saved'))
+    for name, before, after in rows:
+        report.write('%-*s %8d %8d %8d\n' % (width, name, before, after, before - after))
+    report.write('%-*s %8d %8d %8d\n' % (width, 'total', total_before, total_after, total_before - total_after))
+    return files, total_before, total_after
+
+
+if __name__ == '__main__':
+    root = sys.argv[1] if len(sys.argv) > 1 else '.'
+    optimize_all(root, sys.argv[2] if len(sys.argv) > 2 else os.path.join(root, 'build', 'palette'))
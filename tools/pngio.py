@@ -0,0 +1,269 @@
+"""Minimal PNG reader/writer used by the resource build steps.
+
+Only what the resource pipeline needs: PNGs of any colour type at bit
+depths 1-8, interlaced or not, are decoded to rows of RGBA tuples, and
+images are written back as palette PNGs at the smallest bit depth their
+colour count allows (or RGBA when they exceed 256 colours). This keeps the build free of third-party imaging packages.
+"""
+
+import os
+import struct
+import zlib
+
+PNG_SIGNATURE = b'\x89PNG\r\n\x1a\n'
+
+
+class Image(object):
+    def __init__(self, width, height, rows):
+        self.width = width
+        self.height = height
+        self.rows = rows  # list of lists of (r, g, b, a)
+
+    @classmethod
+    def blank(cls, width, height, color=(0, 0, 0, 0)):
+        return cls(width, height, [[color] * width for _ in range(height)])
+
+    def paste(self, other, x, y):
+        for row in range(other.height):
+            self.rows[y + row][x:x + other.width] = other.rows[row]
+
+    def colors(self):
+        seen = {}
+        for row in self.rows:
+            for px in row:
+                seen[px] = True
+        return list(seen)
+
+
+def _chunks(data):
+    pos = len(PNG_SIGNATURE)
+    while pos < len(data):
+        length, tag = struct.unpack('>I4s', data[pos:pos + 8])
+        yield tag, data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+
+
+def _paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def _unfilter(raw, height, stride, bpp):
+    rows = []
+    prev = bytearray(stride)
+    pos = 0
+    for _ in range(height):
+        ftype = raw[pos]
+        cur = bytearray(raw[pos + 1:pos + 1 + stride])
+        pos += 1 + stride
+        for i in range(stride):
+            left = cur[i - bpp] if i >= bpp else 0
+            up = prev[i]
+            if ftype == 1:
+                cur[i] = (cur[i] + left) & 0xff
+            elif ftype == 2:
+                cur[i] = (cur[i] + up) & 0xff
+            elif ftype == 3:
+                cur[i] = (cur[i] + ((left + up) >> 1)) & 0xff
+            elif ftype == 4:
+                upleft = prev[i - bpp] if i >= bpp else 0
+                cur[i] = (cur[i] + _paeth(left, up, upleft)) & 0xff
+        rows.append(cur)
+        prev = cur
+    return rows
+
+
+def _samples(row, count, depth):
+    if depth == 8:
+        return list(row[:count])
+    per_byte = 8 // depth
+    mask = (1 << depth) - 1
+    out = []
+    for i in range(count):
+        byte = row[i // per_byte]
+        shift = 8 - depth * (i % per_byte + 1)
+        out.append((byte >> shift) & mask)
+    return out
+
+
+# Adam7 passes: (x start, y start, x step, y step)
+ADAM7 = [(0, 0, 8, 8), (4, 0, 8, 8), (0, 4, 4, 8), (2, 0, 4, 4),
+         (0, 2, 2, 4), (1, 0, 2, 2), (0, 1, 1, 2)]
+
+
+def size(path):
+    """Return (width, height) from the IHDR chunk without decoding pixels."""
+    with open(path, 'rb') as f:
+        return struct.unpack('>II', f.read(24)[16:24])
+
+
+def ihdr(path):
+    """Return (width, height, bit depth, colour type) from the IHDR chunk."""
+    with open(path, 'rb') as f:
+        return struct.unpack('>IIBB', f.read(26)[16:26])
+
+
+def palette_depth(count):
+    """Smallest palette PNG bit depth that holds count colours."""
+    for depth in (1, 2, 4, 8):
+        if count <= 1 << depth:
+            return depth
+    return None
+
+
+def pack(indices, depth):
+    """Indices at depth bits each, most significant first, as PNG rows hold them."""
+    if depth == 8:
+        return bytearray(indices)
+    per_byte = 8 // depth
+    out = bytearray((len(indices) + per_byte - 1) // per_byte)
+    for i, v in enumerate(indices):
+        out[i // per_byte] |= v << (8 - depth * (i % per_byte + 1))
+    return out
+
+
+def _to_rgba(s, width, ctype, depth, palette, trns):
+    scale = 255 // ((1 << depth) - 1)
+    row = []
+    for x in range(width):
+        if ctype == 0:
+            v = s[x]
+            alpha = 0 if trns and v == struct.unpack('>H', trns[:2])[0] else 255
+            row.append((v * scale, v * scale, v * scale, alpha))
+        elif ctype == 2:
+            rgb = tuple(s[x * 3:x * 3 + 3])
+            alpha = 0 if trns and rgb == struct.unpack('>HHH', trns[:6]) else 255
+            row.append(rgb + (alpha,))
+        elif ctype == 3:
+            alpha = trns[s[x]] if trns and s[x] < len(trns) else 255
+            row.append(palette[s[x]] + (alpha,))
+        elif ctype == 4:
+            v, alpha = s[x * 2:x * 2 + 2]
+            row.append((v, v, v, alpha))
+        else:
+            row.append(tuple(s[x * 4:x * 4 + 4]))
+    return row
+
+
+def _load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if not data.startswith(PNG_SIGNATURE):
+        raise ValueError('%s: not a PNG file' % path)
+
+    idat = b''
+    palette = []
+    trns = None
+    for tag, body in _chunks(data):
+        if tag == b'IHDR':
+            width, height, depth, ctype, _, _, interlace = struct.unpack('>IIBBBBB', body)
+        elif tag == b'PLTE':
+            palette = [tuple(body[i:i + 3]) for i in range(0, len(body), 3)]
+        elif tag == b'tRNS':
+            trns = body
+        elif tag == b'IDAT':
+            idat += body
+    if depth > 8:
+        raise ValueError('%s: 16-bit PNGs are not supported' % path)
+    return width, height, depth, ctype, interlace, palette, trns, idat
+
+
+def _decode(path, to_row):
+    """Rows of the image at path, each made by to_row(samples, width, ...) from its samples."""
+    width, height, depth, ctype, interlace, palette, trns, idat = _load(path)
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[ctype]
+    bpp = max(1, channels * depth // 8)
+    raw = zlib.decompress(idat)
+
+    def decode(pos, w, h):
+        stride = (w * channels * depth + 7) // 8
+        rows = [to_row(_samples(r, w * channels, depth), w, ctype, depth, palette, trns)
+                for r in _unfilter(raw[pos:], h, stride, bpp)]
+        return rows, pos + (1 + stride) * h if w else pos
+
+    if not interlace:
+        return width, height, decode(0, width, height)[0]
+
+    image = [[None] * width for _ in range(height)]
+    pos = 0
+    for x0, y0, dx, dy in ADAM7:
+        w = (width - x0 + dx - 1) // dx
+        h = (height - y0 + dy - 1) // dy
+        if w <= 0 or h <= 0:
+            continue
+        rows, pos = decode(pos, w, h)
+        for j, row in enumerate(rows):
+            image[y0 + j * dy][x0::dx] = row
+    return width, height, image
+
+
+def read_indexed(path):
+    """Palette PNG as indices: (width, height, depth, palette, rows).
+
+    palette holds (r, g, b, a) per entry and rows the palette index of each
+    pixel. Non-palette images raise ValueError.
+    """
+    _, _, depth, ctype = ihdr(path)
+    if ctype != 3:
+        raise ValueError('%s: not a palette PNG' % path)
+    _, _, _, _, _, palette, trns, _ = _load(path)
+    alphas = bytearray(trns or b'')
+    palette = [rgb + (alphas[i] if i < len(alphas) else 255,) for i, rgb in enumerate(palette)]
+    width, height, rows = _decode(path, lambda samples, *_: samples)
+    return width, height, depth, palette, rows
+
+
+def read(path):
+    return Image(*_decode(path, _to_rgba))
+
+
+def _chunk(tag, body):
+    return (struct.pack('>I', len(body)) + tag + body +
+            struct.pack('>I', zlib.crc32(tag + body) & 0xffffffff))
+
+
+def encode(image):
+    """image as a palette PNG, or RGBA if it has too many colours."""
+    colors = image.colors()
+    raw = bytearray()
+    depth = palette_depth(len(colors))
+    if depth:
+        colors.sort(key=lambda c: (c[3], c))  # transparent entries first keeps tRNS short
+        index = dict((c, i) for i, c in enumerate(colors))
+        for row in image.rows:
+            raw.append(0)
+            raw.extend(pack([index[px] for px in row], depth))
+        header = struct.pack('>IIBBBBB', image.width, image.height, depth, 3, 0, 0, 0)
+        chunks = [_chunk(b'IHDR', header),
+                  _chunk(b'PLTE', b''.join(bytes(bytearray(c[:3])) for c in colors))]
+        alphas = [c[3] for c in colors]
+        while alphas and alphas[-1] == 255:
+            alphas.pop()
+        if alphas:
+            chunks.append(_chunk(b'tRNS', bytes(bytearray(alphas))))
+    else:
+        for row in image.rows:
+            raw.append(0)
+            for px in row:
+                raw.extend(px)
+        header = struct.pack('>IIBBBBB', image.width, image.height, 8, 6, 0, 0, 0)
+        chunks = [_chunk(b'IHDR', header)]
+
+    chunks.append(_chunk(b'IDAT', zlib.compress(bytes(raw), 9)))
+    chunks.append(_chunk(b'IEND', b''))
+    return PNG_SIGNATURE + b''.join(chunks)
+
+
+def write(path, image):
+    """Encode image to path, leaving the file alone when it already holds exactly that."""
+    data = encode(image)
+    if os.path.exists(path):
+        with open(path, 'rb') as f:
+            if f.read() == data:
+                return
+    with open(path, 'wb') as f:
+        f.write(data)
@@ -0,0 +1,164 @@
+"""Convert PNG resources to raw, pre-decoded bitmap blobs.
+
+gbitmap_create_with_resource() takes either a PNG or the firmware's own
+bitmap layout, a 12-byte header followed by the pixel rows and, for
+palettized formats, the palette. A PNG has to be copied to the heap,
+inflated and unfiltered before the bitmap exists; a raw blob is read
+straight into the bitmap's buffer. Raw blobs cost more flash, so the
+build only converts the resources it is asked to (wscript --raw-images),
+and host/decode.c measures which ones are worth it. Both start from the
+copies palette.py leaves under build/, which is what the build would
+otherwise ship as PNGs.
+
+Blobs are written as the platforms would decode the PNG: aplite gets a
+1-bit bitmap (rows padded to 32 bits, least significant bit first, white
+where a pixel is opaque and at least mid grey: an approximation of the
+firmware's own conversion, which host/decode.c shares), the
+colour platforms a 1-, 2- or 4-bit palettized one at the PNG's own depth
+or an 8-bit one otherwise.
+"""
+
+import json
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import palette
+import pngio
+
+RESOURCES_DIR = 'resources'
+
+# GBitmapFormat values
+FORMAT_1BIT = 0
+FORMAT_8BIT = 1
+FORMAT_PALETTE = {1: 2, 2: 3, 4: 4}
+BITMAP_VERSION = 1
+
+
+def gcolor8(px):
+    """GColor8 byte, two bits each of alpha, red, green and blue."""
+    r, g, b, a = [v // 85 for v in palette.pebble_color(px)]
+    return a << 6 | r << 4 | g << 2 | b
+
+
+def _header(row_size, fmt, width, height):
+    return struct.pack('<HHhhhh', row_size, fmt << 1 | BITMAP_VERSION << 12, 0, 0, width, height)
+
+
+def blob_1bit(path):
+    """aplite's bitmap of the PNG at path: white where the pixel is light and opaque."""
+    image = pngio.read(path)
+    row_size = (image.width + 31) // 32 * 4
+    data = bytearray(_header(row_size, FORMAT_1BIT, image.width, image.height))
+    for row in image.rows:
+        bits = bytearray(row_size)
+        for x, (r, g, b, a) in enumerate(row):
+            if a >= 128 and r + g + b >= 3 * 128:
+                bits[x // 8] |= 1 << (x % 8)
+        data.extend(bits)
+    return bytes(data)
+
+
+def blob_color(path):
+    """The colour platforms' bitmap of the PNG at path."""
+    width, height, depth, ctype = pngio.ihdr(path)
+    if ctype == 3 and depth in FORMAT_PALETTE:
+        width, height, depth, colors, rows = pngio.read_indexed(path)
+        row_size = (width * depth + 7) // 8
+        data = bytearray(_header(row_size, FORMAT_PALETTE[depth], width, height))
+        for row in rows:
+            data.extend(pngio.pack(row, depth))
+        entries = [gcolor8(c) for c in colors] + [0] * ((1 << depth) - len(colors))
+        data.extend(bytearray(entries))
+        return bytes(data)
+
+    image = pngio.read(path)
+    data = bytearray(_header(image.width, FORMAT_8BIT, image.width, image.height))
+    for row in image.rows:
+        data.extend(bytearray(gcolor8(px) for px in row))
+    return bytes(data)
+
+
+def _write_if_changed(source, target, convert):
+    """Converts source into target, leaving target alone when it already holds the result;
+    content decides, not file times, which a fresh clone does not keep in order."""
+    data = convert(source)
+    if os.path.exists(target):
+        with open(target, 'rb') as f:
+            if f.read() == data:
+                return
+    if not os.path.isdir(os.path.dirname(target)):
+        os.makedirs(os.path.dirname(target))
+    with open(target, 'wb') as f:
+        f.write(data)
+
+
+def blob_paths(root, entry):
+    """(png for aplite, png for colour) of a png media entry."""
+    path = os.path.normpath(os.path.join(root, RESOURCES_DIR, entry['file']))
+    colored = palette.color_variant(path)
+    return path, colored if os.path.exists(colored) else path
+
+
+def read_names(value):
+    """The resource names a --raw-images value stands for: 'all', a comma separated list,
+    or the file host/decode.c writes its pick to."""
+    if os.path.isfile(value):
+        with open(value) as f:
+            value = f.read()
+    value = value.strip()
+    return 'all' if value == 'all' else set(name for name in value.split(',') if name)
+
+
+def convert(root, media, names, platforms, out_dir):
+    """media with the png entries named in names (or all of them when names is
+    'all') swapped for raw blobs, written to out_dir.
+
+    A raw resource has one file for every platform, so each converted image
+    becomes one entry per platform family, told apart by targetPlatforms.
+    """
+    converted = []
+    for entry in media:
+        if entry['type'] != 'png' or (names != 'all' and entry['name'] not in names):
+            converted.append(entry)
+            continue
+        mono, colored = blob_paths(root, entry)
+        families = [('aplite', blob_1bit, mono, [p for p in platforms if p == 'aplite']),
+                    ('color', blob_color, colored, [p for p in platforms if p != 'aplite'])]
+        for family, blob, source, targets in families:
+            if not targets:
+                continue
+            target = os.path.join(out_dir, '%s-%s.pbi' % (entry['name'], family))
+            _write_if_changed(source, target, blob)
+            converted.append({'type': 'raw', 'name': entry['name'], 'targetPlatforms': targets,
+                              'file': os.path.relpath(target, os.path.join(root, RESOURCES_DIR))})
+    return converted
+
+
+def write_host(root, out_dir):
+    """Blobs of every png resource for host/decode.c, and its manifest: the
+    platform families the app targets, then one line of family, name, png
+    path and blob path per blob. The PNGs are palette.py's copies, made
+    under out_dir the way the build makes them."""
+    with open(os.path.join(root, 'appinfo.json')) as f:
+        info = json.load(f)
+    media = info['resources']['media']
+    with open(os.devnull, 'w') as quiet:
+        files, _, _ = palette.optimize_all(root, os.path.join(out_dir, 'palette'), quiet)
+    families = set('aplite' if p == 'aplite' else 'color' for p in info.get('targetPlatforms', ['aplite']))
+    lines = ['targets %s\n' % ' '.join(sorted(families))]
+    for entry in media:
+        if entry['type'] != 'png':
+            continue
+        mono, colored = blob_paths(root, dict(entry, file=files[entry['name']]))
+        for platform, blob, source in (('aplite', blob_1bit, mono), ('color', blob_color, colored)):
+            target = os.path.join(out_dir, '%s-%s.pbi' % (entry['name'], platform))
+            _write_if_changed(source, target, blob)
+            lines.append('%s %s %s %s\n' % (platform, entry['name'], source, target))
+    with open(os.path.join(out_dir, 'manifest.txt'), 'w') as f:
+        f.writelines(lines)
+
+
+if __name__ == '__main__':
+    write_host(sys.argv[1], sys.argv[2])